@@ -0,0 +1,87 @@
+#ifndef MEASURE_HPP
+#define MEASURE_HPP
+
+// Timing helpers of the benchmarks. Every measurement is repeated several times and
+// summarized by the median and the median absolute deviation (MAD), which, unlike the mean
+// and the standard deviation, are not thrown off by a few runs slowed down by the system.
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+struct Measurement
+{
+    // time of one operation in nanoseconds
+    double Median, MAD;
+};
+
+inline double Median(std::vector<double> values)
+{
+    if(values.empty())
+        return 0;
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    const double upper = values[middle];
+    if(values.size() % 2)
+        return upper;
+    return (*std::max_element(values.begin(), values.begin() + middle) + upper) / 2;
+}
+
+inline Measurement Summarize(const std::vector<double> &samples)
+{
+    Measurement measurement;
+    measurement.Median = Median(samples);
+    std::vector<double> deviations(samples.size());
+    for(size_t i = 0; i < samples.size(); ++i)
+        deviations[i] = samples[i] > measurement.Median ? samples[i] - measurement.Median :
+            measurement.Median - samples[i];
+    measurement.MAD = Median(deviations);
+    return measurement;
+}
+
+// Times samples runs of f, which does operations operations, e.g. traces so many rays.
+template<class Function>
+Measurement Measure(const int samples, const uint64_t operations, Function f)
+{
+    std::vector<double> times(samples);
+    for(int i = 0; i < samples; ++i)
+    {
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        f();
+        times[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() /
+            (double)operations;
+    }
+    return Summarize(times);
+}
+
+// Same as above for f(repetitions), which repeats a short operation so many times. The
+// number of repetitions is chosen, so that one run takes at least minimumMilliseconds.
+template<class Function>
+Measurement MeasureRepeated(const int samples, Function f, const double minimumMilliseconds = 20)
+{
+    uint64_t repetitions = 1;
+    for(;;)
+    {
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        f(repetitions);
+        const double milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin).count();
+        if(milliseconds >= minimumMilliseconds || repetitions >= (1ull << 40))
+            break;
+        repetitions = (uint64_t)(repetitions * (milliseconds > 0 ?
+            std::min(100., std::max(2., 1.5 * minimumMilliseconds / milliseconds)) : 100.));
+    }
+    return Measure(samples, repetitions, [&] { f(repetitions); });
+}
+
+// Prints a line of the benchmark's table: name, median and MAD in the given unit.
+inline void Report(const char *name, const Measurement &measurement, const char *unit = "ns",
+    const double nanosecondsPerUnit = 1)
+{
+    printf("%-40s %12.3f %10.3f %s\n", name, measurement.Median / nanosecondsPerUnit,
+        measurement.MAD / nanosecondsPerUnit, unit);
+    fflush(stdout);
+}
+#endif // MEASURE_HPP
@@ -0,0 +1,90 @@
+// Compares matching pixels to palette colors by walking the palette's k-d tree with
+// looking them up in a GifPaletteLookup, on the frames of the demo animation.
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include "../include/Vector.hpp"
+#include "../source/Renderer.cpp"
+#include "../source/DemoScene.cpp"
+#include "../include/gif.h"
+
+// Time of the fastest of several runs of f in microseconds.
+template<class Function>
+long long MinimumTime(const int runs, Function f)
+{
+    long long best = -1;
+    for(int i = 0; i < runs; ++i)
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        f();
+        const long long time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        if(best < 0 || time < best)
+            best = time;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    const uint32_t totalFrames = argc > 1 ? (uint32_t)atoi(argv[1]) : 16;
+    const int runs = 5;
+    Renderer renderer(512, 512, 8);
+    DemoScene scene(renderer);
+    const uint32_t width = renderer.Width, height = renderer.Height, numPixels = width * height;
+
+    // the previous frame quantized by the tree and as it was rendered
+    std::vector<uint8_t> previous(numPixels * 4), previousSource(numPixels * 4), tree(numPixels * 4), lookup(numPixels * 4);
+    GifPaletteLookup *table = new GifPaletteLookup;
+    long long totalTree = 0, totalLookup = 0;
+    uint64_t totalDifferent = 0;
+    int64_t totalError = 0;
+    std::cout << "frame  tree[us]  lookup[us]  different pixels  mean extra error of different\n";
+    for(uint32_t frame = 0; frame < totalFrames; ++frame)
+    {
+        scene.PrepareFrame();
+        renderer.RenderFrame();
+        scene.Advance();
+
+        // the same palette and previous frames as GifWriteFrame uses: the palette is built for
+        // the pixels changed since the previous rendered frame
+        const uint8_t *oldImage = frame == 0 ? NULL : previous.data(),
+            *oldSource = frame == 0 ? NULL : previousSource.data();
+        GifPalette palette;
+        GifMakePalette(oldSource, renderer.FrameBuffer, width, height, 8, false, &palette);
+
+        const long long treeTime = MinimumTime(runs, [&]
+            { GifThresholdImage(oldImage, renderer.FrameBuffer, tree.data(), width, height, &palette, NULL, oldSource); });
+        // the table is cleared in every run, because a new palette needs a new table
+        const long long lookupTime = MinimumTime(runs, [&]
+        {
+            GifClearPaletteLookup(table);
+            GifThresholdImage(oldImage, renderer.FrameBuffer, lookup.data(), width, height, &palette, table, oldSource);
+        });
+
+        uint64_t different = 0;
+        // how much farther from the rendered colors the looked up colors are (sum over RGB)
+        int64_t error = 0;
+        for(uint32_t i = 0; i < numPixels * 4; i += 4)
+            if(tree[i + 3] != lookup[i + 3])
+            {
+                ++different;
+                for(int c = 0; c < 3; ++c)
+                    error += abs((int)lookup[i + c] - (int)renderer.FrameBuffer[i + c]) -
+                        abs((int)tree[i + c] - (int)renderer.FrameBuffer[i + c]);
+            }
+        std::cout << frame << "  " << treeTime << "  " << lookupTime << "  " << different << "  " <<
+            (different ? (double)error / different : 0.) << '\n';
+        totalTree += treeTime;
+        totalLookup += lookupTime;
+        totalDifferent += different;
+        totalError += error;
+        previous = tree;
+        previousSource.assign(renderer.FrameBuffer, renderer.FrameBuffer + numPixels * 4);
+    }
+    std::cout << "total  " << totalTree << "  " << totalLookup << "  " << totalDifferent << "  " <<
+        (totalDifferent ? (double)totalError / totalDifferent : 0.) << '\n' <<
+        "speedup " << (double)totalTree / totalLookup << '\n';
+    delete table;
+    return 0;
+}
@@ -0,0 +1,237 @@
+// Benchmarks of every level of the renderer, from single intersection tests to whole
+// frames and their encoding:
+// - intersect/SHAPE: finding the hit in a compiled scene of one shape, per ray
+// - scene/N: finding the closest of N spheres (and a floor), per ray
+// - trace/depth-N: tracing rays of the demo scene with MaxDepth N, per primary ray
+// - frame/WxH/N: RenderFrame of the demo scene with N threads, per frame
+// - gif/...: encoding frames of the demo animation to a file, per frame
+// Every line shows the median and the median absolute deviation of several runs.
+// Only benchmarks whose names contain the first argument, if given, are run, e.g.
+// "RenderingBenchmark frame/".
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include "../include/Vector.hpp"
+#include "../source/Renderer.cpp"
+#include "../source/DemoScene.cpp"
+#include "../include/GifParallel.hpp"
+#include "Measure.hpp"
+
+// Results are added to this, so the compiler cannot drop the measured work.
+volatile float Sink;
+
+const int Samples = 9;
+std::string Filter;
+
+bool Selected(const std::string &name)
+{
+    return name.find(Filter) != std::string::npos;
+}
+
+float RandomFloat(const float minimum, const float maximum)
+{
+    return minimum + (maximum - minimum) * (rand() / (float)RAND_MAX);
+}
+
+Vec3f RandomVector(const float minimum, const float maximum)
+{
+    return Vec3f(RandomFloat(minimum, maximum), RandomFloat(minimum, maximum), RandomFloat(minimum, maximum));
+}
+
+// Rays from around (0, 0, 5) towards random points of the cube [-2, 2]^3 around the
+// origin, so most of them hit shapes of size 2 at the origin.
+void MakeRays(const size_t count, std::vector<Vec3f> &origins, std::vector<Vec3f> &directions)
+{
+    origins.resize(count);
+    directions.resize(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        origins[i] = Vec3f(0, 0, 5) + RandomVector(-1, 1);
+        directions[i] = (RandomVector(-2, 2) - origins[i]).Normalize();
+    }
+}
+
+// Every shape is intersected the way frames are rendered, through the arrays of its type in
+// CompiledScene, not through the virtual Shape::RayIntersect.
+void BenchmarkShapes()
+{
+    const Material material(1.0, Vec4f(0.6, 0.3, 0.1, 0.0), Vec3f(0.4, 0.4, 0.3), 50.);
+    const Vec3f facing = Vec3f(0.2f, 0.3f, 1).Normalize();
+    Shape *shapes[] =
+    {
+        new Sphere(Vec3f(0, 0, 0), 1, material),
+        new Plane(Vec3f(0, 0, 0), facing, material),
+        new Circle(Vec3f(0, 0, 0), 1, facing, material),
+        new Rectangle(Vec3f(0, 0, 0), 2, 1.5f, facing, material),
+        new Ellipse(Vec3f(-0.5f, 0, 0), Vec3f(0.5f, 0, 0), 1, facing, material)
+    };
+    const char *names[] = { "Sphere", "Plane", "Circle", "Rectangle", "Ellipse" };
+
+    std::vector<Vec3f> origins, directions;
+    MakeRays(4096, origins, directions);
+    for(size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s)
+    {
+        const std::string name = std::string("intersect/") + names[s];
+        // deletes the shape
+        Renderer renderer(1, 1, 1, false);
+        renderer.Shapes.push_back(shapes[s]);
+        if(!Selected(name))
+            continue;
+        renderer.CompileScene();
+        Report(name.c_str(), MeasureRepeated(Samples, [&](const uint64_t repetitions)
+        {
+            float sum = 0;
+            HitRecord hit;
+            for(uint64_t r = 0; r < repetitions; ++r)
+            {
+                const size_t i = r & 4095;
+                if(renderer.IntersectRay(origins[i], directions[i], hit))
+                    sum += hit.Distance;
+            }
+            Sink = sum;
+        }));
+    }
+}
+
+void BenchmarkScene()
+{
+    const Material material(1.0, Vec4f(0.6, 0.3, 0.1, 0.0), Vec3f(0.4, 0.4, 0.3), 50.);
+    std::vector<Vec3f> origins, directions;
+    MakeRays(4096, origins, directions);
+    for(int count = 10; count <= 1000000; count *= 10)
+    {
+        const std::string name = "scene/" + std::to_string(count);
+        if(!Selected(name))
+            continue;
+        Renderer renderer(1, 1, 1);
+        srand(count);
+        // the spheres fill the cube [-2, 2]^3 about as densely at every count
+        const float radius = 1.5f / cbrtf((float)count);
+        for(int i = 0; i < count; ++i)
+            renderer.Shapes.push_back(new Sphere(RandomVector(-2, 2), radius, material));
+        renderer.Shapes.push_back(new Plane(Vec3f(0, -3, 0), Vec3f(0, 1, 0), material));
+        renderer.CompileScene();
+        Report(name.c_str(), MeasureRepeated(Samples, [&](const uint64_t repetitions)
+        {
+            float sum = 0;
+            HitRecord hit;
+            for(uint64_t r = 0; r < repetitions; ++r)
+            {
+                const size_t i = r & 4095;
+                if(renderer.IntersectRay(origins[i], directions[i], hit))
+                    sum += hit.Distance;
+            }
+            Sink = sum;
+        }));
+    }
+}
+
+void BenchmarkTracing()
+{
+    for(int depth = 1; depth <= 5; ++depth)
+    {
+        const std::string name = "trace/depth-" + std::to_string(depth);
+        if(!Selected(name))
+            continue;
+        Renderer renderer(128, 128, 1);
+        DemoScene scene(renderer);
+        scene.PrepareFrame();
+        renderer.MaxDepth = (byte)depth;
+        renderer.CompileScene();
+        // the primary rays of a 128x128 frame
+        std::vector<Vec3f> directions;
+        for(int y = 64; y > -64; --y)
+            for(int x = -64; x < 64; ++x)
+                directions.push_back(renderer.Eye.GetScreenPixelPosition(x, y).Normalize());
+        Report(name.c_str(), MeasureRepeated(Samples, [&](const uint64_t repetitions)
+        {
+            float sum = 0;
+            for(uint64_t r = 0; r < repetitions; ++r)
+                sum += renderer.TraceRay(renderer.Eye.Position, directions[r % directions.size()]).X;
+            Sink = sum;
+        }));
+    }
+}
+
+void BenchmarkFrames()
+{
+    const int sizes[] = { 256, 512, 1024 };
+    const int threads[] = { 1, 2, 4, 8 };
+    for(const int size : sizes)
+        for(const int threadCount : threads)
+        {
+            const std::string name = "frame/" + std::to_string(size) + "x" + std::to_string(size) + "/" +
+                std::to_string(threadCount);
+            if(!Selected(name))
+                continue;
+            Renderer renderer(size, size, (byte)threadCount);
+            DemoScene scene(renderer);
+            scene.PrepareFrame();
+            renderer.RenderFrame(); // warm-up
+            Report(name.c_str(), Measure(size > 512 ? 5 : Samples, 1, [&] { renderer.RenderFrame(); }), "ms", 1e6);
+        }
+}
+
+void BenchmarkEncoding()
+{
+    const bool gif = Selected("gif/GifWriteFrame"), parallel = Selected("gif/GifParallelWriter"),
+        lookup = Selected("gif/GifParallelWriter+lookup");
+    if(!gif && !parallel && !lookup)
+        return;
+    // the frames of the demo animation
+    const uint32_t totalFrames = 16, delay = 20;
+    Renderer renderer(512, 512, 8);
+    DemoScene scene(renderer);
+    std::vector<std::vector<byte>> frames(totalFrames);
+    for(uint32_t i = 0; i < totalFrames; ++i)
+    {
+        scene.PrepareFrame();
+        renderer.RenderFrame();
+        frames[i].assign(renderer.FrameBuffer, renderer.FrameBuffer + renderer.FrameSize());
+        scene.Advance();
+    }
+
+    // all writers write the same file
+    const char *fileName = "RenderingBenchmark.gif";
+    if(gif)
+    {
+        Report("gif/GifWriteFrame", Measure(5, totalFrames, [&]
+        {
+            GifWriter writer;
+            GifBegin(&writer, fileName, renderer.Width, renderer.Height, delay);
+            for(uint32_t i = 0; i < totalFrames; ++i)
+                GifWriteFrame(&writer, frames[i].data(), renderer.Width, renderer.Height, delay);
+            GifEnd(&writer);
+        }), "ms", 1e6);
+    }
+    for(int usePaletteLookup = 0; usePaletteLookup < 2; ++usePaletteLookup)
+    {
+        if(!(usePaletteLookup ? lookup : parallel))
+            continue;
+        GifParallelWriter writer(renderer.TotalThreads);
+        writer.UsePaletteLookup = usePaletteLookup != 0;
+        Report(usePaletteLookup ? "gif/GifParallelWriter+lookup" : "gif/GifParallelWriter", Measure(5, totalFrames, [&]
+        {
+            writer.Begin(fileName, renderer.Width, renderer.Height, delay);
+            for(uint32_t i = 0; i < totalFrames; ++i)
+                writer.WriteFrame(frames[i].data(), renderer.Width, renderer.Height, delay);
+            writer.End();
+        }), "ms", 1e6);
+    }
+    remove(fileName);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc > 1)
+        Filter = argv[1];
+    printf("%-40s %12s %10s\n", "benchmark", "median", "MAD");
+    BenchmarkShapes();
+    BenchmarkScene();
+    BenchmarkTracing();
+    BenchmarkFrames();
+    BenchmarkEncoding();
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Scaling report: time of rendering a frame of every generated scene (see SceneGenerator)
+// against the number of shapes (or lights) and the number of threads. Compiling the scene,
+// which is done before the first frame, and updating it after the shapes moved, which is
+// done before every other frame, are reported separately.
+// Arguments: the largest number of shapes (1000000 by default), the size of the frames
+// (256 by default) and the seed (1 by default).
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../include/Vector.hpp"
+#include "../source/Renderer.cpp"
+#include "../source/SceneGenerator.cpp"
+#include "Measure.hpp"
+
+int main(int argc, char *argv[])
+{
+    const uint32_t maximumCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+    const int size = argc > 2 ? atoi(argv[2]) : 256;
+    const uint32_t seed = argc > 3 ? (uint32_t)atoi(argv[3]) : 1;
+    const int threads[] = { 1, 2, 4, 8, 16 };
+    const char *names[] = { "spheres", "rectangles", "ellipses", "lights" };
+
+    printf("%dx%d frames, seed %u, %u hardware threads\n", size, size, seed, std::thread::hardware_concurrency());
+    printf("%-11s %9s %8s %12s %10s %12s %10s %12s %10s %8s\n", "scene", "count", "threads", "compile[ms]", "MAD",
+        "update[ms]", "MAD", "render[ms]", "MAD", "speedup");
+    for(int kind = 0; kind < 4; ++kind)
+    {
+        // every light adds a shadow ray to every shaded point, so there are fewer of them
+        const uint32_t largest = kind == (int)GeneratedScene::Lights ? std::min(maximumCount, 1000u) : maximumCount;
+        for(uint32_t count = 10; count <= largest; count *= 10)
+        {
+            // the scene is made once and lent to the renderer of every number of threads
+            Renderer scene(1, 1, 1, false);
+            SceneGenerator(seed).Generate(scene, (GeneratedScene)kind, count);
+            double singleThread = 0;
+            for(const int threadCount : threads)
+            {
+                Renderer renderer(size, size, (byte)threadCount);
+                renderer.Shapes.swap(scene.Shapes);
+                renderer.Lights.swap(scene.Lights);
+                const int samples = count >= 100000 ? 3 : 7;
+                const Measurement compile = Measure(samples, 1, [&]
+                {
+                    renderer.InvalidateScene();
+                    renderer.CompileScene();
+                });
+                const Measurement update = Measure(samples, 1, [&] { renderer.CompileScene(); });
+                const Measurement render = Measure(samples, 1, [&] { renderer.RenderRows(renderer.FrameBuffer, 0, size); });
+                if(threadCount == 1)
+                    singleThread = render.Median;
+                printf("%-11s %9u %8d %12.3f %10.3f %12.3f %10.3f %12.3f %10.3f %8.2f\n", names[kind], count,
+                    threadCount, compile.Median / 1e6, compile.MAD / 1e6, update.Median / 1e6, update.MAD / 1e6,
+                    render.Median / 1e6, render.MAD / 1e6, singleThread / render.Median);
+                fflush(stdout);
+                renderer.Shapes.swap(scene.Shapes);
+                renderer.Lights.swap(scene.Lights);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Measures loading a scene of many spheres from the text and the binary scene files, and
+// building and compiling it in a renderer, which is needed before the first frame. The files are written to the current directory.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include "../include/Vector.hpp"
+#include "../source/SceneFile.cpp"
+
+// Time of the fastest of several runs of f in microseconds.
+template<class Function>
+long long MinimumTime(const int runs, Function f)
+{
+    long long best = -1;
+    for(int i = 0; i < runs; ++i)
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        f();
+        const long long time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        if(best < 0 || time < best)
+            best = time;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    const uint32_t sphereCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+    const int runs = 5;
+    const std::string textName = "SceneLoading.txt", binaryName = "SceneLoading.scene";
+
+    // spheres on a grid behind a floor, each with a random material of 16
+    FILE *text = fopen(textName.c_str(), "w");
+    if(!text)
+    {
+        std::cerr << "cannot write " << textName << '\n';
+        return 1;
+    }
+    srand(1);
+    for(int i = 0; i < 16; ++i)
+        fprintf(text, "material m%d 1 0.6 0.3 0.1 0 %.3f %.3f %.3f 50\n", i,
+            rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+    fprintf(text, "light -5 10 -1 1.5\nplane 0 -4 0 0 1 0 m0\ncamera 0 0 5\n");
+    const uint32_t side = (uint32_t)ceil(sqrt((double)sphereCount));
+    for(uint32_t i = 0; i < sphereCount; ++i)
+        fprintf(text, "sphere %.2f %.2f %.2f 0.4 m%d\n", (float)(i % side) - side / 2.f,
+            (float)(i / side) * 0.1f, -10.f - (float)(i / side), rand() & 15);
+    fclose(text);
+
+    SceneFile scene;
+    std::string error;
+    const long long textTime = MinimumTime(runs, [&] { scene.Load(textName, error); });
+    if(!scene.Load(textName, error) || !scene.SaveBinary(binaryName))
+    {
+        std::cerr << error << '\n';
+        return 1;
+    }
+    const long long binaryTime = MinimumTime(runs, [&] { scene.Load(binaryName, error); });
+    if(!scene.Load(binaryName, error))
+    {
+        std::cerr << error << '\n';
+        return 1;
+    }
+    // the renderer needs both, before the first frame is rendered
+    Renderer renderer(512, 512, 1);
+    const long long buildTime = MinimumTime(1, [&] { scene.Build(renderer); });
+    const long long compileTime = MinimumTime(1, [&] { renderer.CompileScene(); });
+
+    std::cout << "shapes " << scene.ShapeCount() << '\n' <<
+        "text loading[us] " << textTime << '\n' <<
+        "binary loading[us] " << binaryTime << '\n' <<
+        "speedup " << (double)textTime / binaryTime << '\n' <<
+        "building[us] " << buildTime << '\n' <<
+        "compiling[us] " << compileTime << '\n' <<
+        "binary loading, building and compiling[us] " << binaryTime + buildTime + compileTime << '\n';
+    remove(textName.c_str());
+    remove(binaryName.c_str());
+    return 0;
+}
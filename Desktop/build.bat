@@ -1,9 +1,30 @@
 rmdir /S /Q build
 mkdir build
+g++ -c source\BandRenderer.cpp -o build\BandRenderer.o
+g++ -c source\BVH.cpp -o build\BVH.o
+g++ -c source\CommandLine.cpp -o build\CommandLine.o
+g++ -c source\DemoScene.cpp -o build\DemoScene.o
+g++ -c source\FramePipeline.cpp -o build\FramePipeline.o
+g++ -c source\Heatmap.cpp -o build\Heatmap.o
 g++ -c source\ImageSaver.cpp -o build\ImageSaver.o
 g++ -c source\Main.cpp -o build\Main.o
+g++ -c source\Packet.cpp -o build\Packet.o
+g++ -c source\RayCounters.cpp -o build\RayCounters.o
 g++ -c source\Renderer.cpp -o build\Renderer.o
+g++ -c source\Scene.cpp -o build\Scene.o
+g++ -c source\SceneFile.cpp -o build\SceneFile.o
+g++ -c source\SceneGenerator.cpp -o build\SceneGenerator.o
 g++ -c source\Shapes.cpp -o build\Shapes.o
-g++ -c source\Vector.cpp -o build\Vector.o
+g++ -c source\ThreadPool.cpp -o build\ThreadPool.o
+g++ -c source\TileScheduler.cpp -o build\TileScheduler.o
+g++ -c source\TimingReport.cpp -o build\TimingReport.o
+g++ -c source\Tracer.cpp -o build\Tracer.o
+g++ -c source\VideoWriter.cpp -o build\VideoWriter.o
 g++ build\* -o 3DRenderer
+g++ -O2 benchmarks\PaletteLookup.cpp -o PaletteLookupBenchmark
+g++ -O2 benchmarks\Rendering.cpp -o RenderingBenchmark
+g++ -O2 benchmarks\Scaling.cpp -o ScalingBenchmark
+g++ -O2 benchmarks\SceneLoading.cpp -o SceneLoadingBenchmark
+g++ -O2 tests\QOIRoundTrip.cpp source\ImageSaver.cpp -o QOIRoundTripTest
+QOIRoundTripTest
 rmdir /S /Q build
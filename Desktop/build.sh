@@ -0,0 +1,17 @@
+#!/bin/sh
+# Linux and macOS version of build.bat.
+set -e
+cd "$(dirname "$0")"
+rm -rf build
+mkdir build
+for source in source/*.cpp; do
+    g++ -pthread -c "$source" -o "build/$(basename "$source" .cpp).o"
+done
+g++ -pthread build/*.o -o 3DRenderer
+g++ -O2 -pthread benchmarks/PaletteLookup.cpp -o PaletteLookupBenchmark
+g++ -O2 -pthread benchmarks/Rendering.cpp -o RenderingBenchmark
+g++ -O2 -pthread benchmarks/Scaling.cpp -o ScalingBenchmark
+g++ -O2 -pthread benchmarks/SceneLoading.cpp -o SceneLoadingBenchmark
+g++ -O2 tests/QOIRoundTrip.cpp source/ImageSaver.cpp -o QOIRoundTripTest
+./QOIRoundTripTest
+rm -rf build
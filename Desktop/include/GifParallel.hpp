@@ -0,0 +1,354 @@
+#ifndef GIF_PARALLEL_HPP
+#define GIF_PARALLEL_HPP
+
+// Multithreaded variant of the gif.h writer. It produces the same file as GifBegin,
+// GifWriteFrame and GifEnd, unless UsePaletteLookup is set.
+// - Picking the changed pixels and thresholding a frame are split across a pool of threads.
+// - The palette's k-d tree is split on one thread near its root and its subtrees are built
+//   in parallel.
+// - Quantized frames are LZW-compressed into memory by background threads, while the next
+//   frames are quantized, and are written to the file in order.
+// Quantizing a frame needs the quantized previous frame, so frames are still quantized one
+// after another. The file is written through an OutputSink and all memory used by a frame is
+// allocated once and reused by the next frames.
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "OutputSink.hpp"
+#include "../source/ThreadPool.cpp"
+#include "../source/Tracer.cpp"
+// the steps of gif.h appear in the timeline of Tracer
+#ifndef GIF_TRACE_SCOPE
+#define GIF_TRACE_SCOPE(name) TraceScope gifTraceScope(name)
+#endif
+#include "gif.h"
+
+// Lets gif.h write to any OutputSink.
+inline void GifPutc( OutputSink* out, int c ) { out->Put((uint8_t)c); }
+inline void GifPutBytes( OutputSink* out, const void* data, size_t size ) { out->Write(data, size); }
+
+class GifParallelWriter
+{
+public:
+    // Match pixels to palette colors using a GifPaletteLookup per thread, which is faster,
+    // but may pick slightly worse colors than walking the palette's k-d tree.
+    bool UsePaletteLookup;
+
+    // numberOfThreads threads quantize every frame and lzwThreads other threads compress
+    // the quantized frames.
+    GifParallelWriter(const byte numberOfThreads, const byte lzwThreads = 1)
+        : UsePaletteLookup(false), Pool(numberOfThreads), Frames((lzwThreads > 0 ? lzwThreads : 1) + 2),
+          Queued(0), Encoding(0), Written(0), Stopping(false)
+    {
+        for(byte i = 0; i < Frames.size() - 2; ++i)
+            Compressors.emplace_back(&GifParallelWriter::CompressorLoop, this);
+    }
+    ~GifParallelWriter()
+    {
+        End();
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Stopping = true;
+        }
+        QueuedCondition.notify_all();
+        for(size_t i = 0; i < Compressors.size(); ++i)
+            Compressors[i].join();
+    }
+    GifParallelWriter(const GifParallelWriter&) = delete;
+    GifParallelWriter& operator=(const GifParallelWriter&) = delete;
+
+    // Same as GifBegin.
+    bool Begin( const char* filename, uint32_t width, uint32_t height, uint32_t delay, int32_t bitDepth = 8, bool dither = false )
+    {
+        return Begin(OpenOutputSink(filename), width, height, delay, bitDepth, dither);
+    }
+
+    // Same as GifBegin, but writes the file to output, which is closed by End.
+    bool Begin( std::unique_ptr<OutputSink> output, uint32_t width, uint32_t height, uint32_t delay, int32_t bitDepth = 8, bool dither = false )
+    {
+        (void)bitDepth; (void)dither;
+        End();
+        if(!output)
+            return false;
+        Output = std::move(output);
+        GifWriteHeader(Output.get(), width, height, delay);
+
+        const size_t imageSize = (size_t)width * height * 4;
+        for(size_t i = 0; i < Frames.size(); ++i)
+            Frames[i].Quantized.resize(imageSize);
+        LastSource.resize(imageSize);
+        std::lock_guard<std::mutex> lock(Mutex);
+        Queued = Encoding = Written = 0;
+        return true;
+    }
+
+    // Same as GifWriteFrame. Returns before the frame is written to the file.
+    bool WriteFrame( const uint8_t* image, uint32_t width, uint32_t height, uint32_t delay, int bitDepth = 8, bool dither = false )
+    {
+        if(!Output) return false;
+        TraceScope trace("GifWriteFrame");
+
+        // the frame's slot must not hold a frame, which is not written yet
+        const size_t n = Queued;
+        if(n >= Frames.size())
+            WriteCompressed(n - Frames.size() + 1);
+        Frame &frame = Frames[n % Frames.size()];
+        frame.Width = width;
+        frame.Height = height;
+        frame.Delay = delay;
+        frame.Compressed = false;
+        const uint8_t* oldImage = n == 0 ? NULL : Frames[(n - 1) % Frames.size()].Quantized.data();
+        const uint8_t* oldSource = n == 0 ? NULL : LastSource.data();
+
+        MakePalette((dither? NULL : oldSource), image, width, height, bitDepth, dither, &frame.Palette);
+        if(dither)
+        {
+            DitherPixels.resize((size_t)width * height * 4);
+            GifDitherImage(oldImage, image, frame.Quantized.data(), width, height, &frame.Palette, DitherPixels.data());
+            memcpy(LastSource.data(), image, (size_t)width * height * 4);
+        }
+        else
+            ThresholdImage(oldImage, oldSource, image, frame.Quantized.data(), width * height, &frame.Palette);
+
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            ++Queued;
+        }
+        QueuedCondition.notify_one();
+        return true;
+    }
+
+    // Writes the remaining frames and closes the file, as GifEnd does. Returns false, if
+    // the file was not opened or could not be written.
+    bool End()
+    {
+        if(!Output) return false;
+        WriteCompressed(Queued);
+        Output->Put(0x3b); // end of file
+        const bool written = Output->Close();
+        Output.reset();
+        return written;
+    }
+
+private:
+    struct Frame
+    {
+        // colors after quantization with palette indices in the alpha channel
+        std::vector<uint8_t> Quantized;
+        GifPalette Palette;
+        uint32_t Width, Height, Delay;
+        MemorySink Output;
+        bool Compressed;
+    };
+
+    // A subtree of the palette's k-d tree with the arguments, with which GifSplitPalette
+    // builds it.
+    struct Subtree
+    {
+        uint8_t* Image;
+        int NumPixels, FirstElt, LastElt, SplitElt, SplitDist, TreeNode;
+    };
+
+    std::unique_ptr<OutputSink> Output;
+    ThreadPool Pool;
+    std::vector<std::thread> Compressors;
+    // Frame i is kept in Frames[i % Frames.size()].
+    std::vector<Frame> Frames;
+    std::mutex Mutex;
+    // Signalled when a frame is quantized or the writer is being destroyed.
+    std::condition_variable QueuedCondition;
+    // Signalled when a frame is compressed.
+    std::condition_variable CompressedCondition;
+    // Numbers of frames quantized, taken by the compressors and written to the file.
+    size_t Queued, Encoding, Written;
+    bool Stopping;
+    // Reused by every frame.
+    // the previous frame passed to WriteFrame
+    std::vector<uint8_t> LastSource;
+    std::vector<int32_t> DitherPixels;
+    std::vector<uint8_t> DestroyableImage;
+    std::vector<int> ChangedPixels;
+    std::vector<Subtree> Subtrees;
+    std::vector<std::unique_ptr<GifPaletteLookup>> Lookups;
+
+    // Pixels [first, end) of numPixels, which are processed by thread threadIndex.
+    void ThreadRange(const byte threadIndex, const uint32_t numPixels, uint32_t &first, uint32_t &end) const
+    {
+        first = (uint32_t)((uint64_t)numPixels * threadIndex / Pool.TotalThreads);
+        end = (uint32_t)((uint64_t)numPixels * (threadIndex + 1) / Pool.TotalThreads);
+    }
+
+    // Same as GifMakePalette.
+    void MakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_t width, uint32_t height, int bitDepth, bool buildForDither, GifPalette* pPal )
+    {
+        TraceScope trace("GifMakePalette");
+        // the frame's palette still holds the entries of an earlier frame, which must not
+        // get into the file, if they are not set for this one (see GifMakePalette)
+        memset(pPal, 0, sizeof(*pPal));
+        pPal->bitDepth = bitDepth;
+
+        // Every thread copies (the changed) pixels of its range to the beginning of the range,
+        // then the ranges are moved together.
+        const uint32_t totalPixels = width * height;
+        DestroyableImage.resize((size_t)totalPixels * 4);
+        ChangedPixels.resize(Pool.TotalThreads);
+        uint8_t* const destroyableImage = DestroyableImage.data();
+        Pool.Run([&](const byte threadIndex)
+        {
+            uint32_t first, end;
+            ThreadRange(threadIndex, totalPixels, first, end);
+            if(!lastFrame)
+            {
+                memcpy(destroyableImage + first * 4, nextFrame + first * 4, (size_t)(end - first) * 4);
+                ChangedPixels[threadIndex] = (int)(end - first);
+                return;
+            }
+            ChangedPixels[threadIndex] = GifCopyChangedPixels(lastFrame + first * 4, nextFrame + first * 4,
+                destroyableImage + first * 4, (int)(end - first));
+        });
+        int numPixels = ChangedPixels[0];
+        for(byte t = 1; t < Pool.TotalThreads; ++t)
+        {
+            uint32_t first, end;
+            ThreadRange(t, totalPixels, first, end);
+            memmove(destroyableImage + numPixels * 4, destroyableImage + first * 4, (size_t)ChangedPixels[t] * 4);
+            numPixels += ChangedPixels[t];
+        }
+
+        const int lastElt = 1 << bitDepth;
+        const int splitElt = lastElt/2;
+        const int splitDist = splitElt/2;
+
+        // split near the root until there are a few subtrees for every thread
+        int levels = 0;
+        while((1 << levels) < 4 * Pool.TotalThreads && levels < bitDepth - 1)
+            ++levels;
+        Subtrees.clear();
+        SplitTopLevels(destroyableImage, numPixels, 1, lastElt, splitElt, splitDist, 1, pPal, Pool.TotalThreads > 1 ? levels : 0);
+        std::atomic<size_t> nextSubtree(0);
+        Pool.Run([&](const byte)
+        {
+            for(size_t i; (i = nextSubtree++) < Subtrees.size(); )
+            {
+                const Subtree &s = Subtrees[i];
+                GifSplitPalette(s.Image, s.NumPixels, s.FirstElt, s.LastElt, s.SplitElt, s.SplitDist, s.TreeNode, buildForDither, pPal);
+            }
+        });
+
+        // add the bottom node for the transparency index
+        pPal->treeSplit[1 << (bitDepth-1)] = 0;
+        pPal->treeSplitElt[1 << (bitDepth-1)] = 0;
+
+        pPal->r[0] = pPal->g[0] = pPal->b[0] = 0;
+    }
+
+    // Copies the pixels of frame, which differ from lastFrame, to the beginning of out.
+    // Returns the number of copied pixels, like GifPickChangedPixels.
+    static int GifCopyChangedPixels( const uint8_t* lastFrame, const uint8_t* frame, uint8_t* out, int numPixels )
+    {
+        int numChanged = 0;
+        for (int ii=0; ii<numPixels; ++ii)
+        {
+            if(lastFrame[0] != frame[0] ||
+               lastFrame[1] != frame[1] ||
+               lastFrame[2] != frame[2])
+            {
+                memcpy(out, frame, 4);
+                ++numChanged;
+                out += 4;
+            }
+            lastFrame += 4;
+            frame += 4;
+        }
+        return numChanged;
+    }
+
+    // Does what GifSplitPalette does for the first levels of the tree and collects the
+    // subtrees below them in Subtrees.
+    void SplitTopLevels(uint8_t* image, int numPixels, int firstElt, int lastElt, int splitElt, int splitDist, int treeNode, GifPalette* pal, int levels)
+    {
+        if(levels == 0 || lastElt <= firstElt+1 || numPixels == 0)
+        {
+            Subtree subtree = { image, numPixels, firstElt, lastElt, splitElt, splitDist, treeNode };
+            Subtrees.push_back(subtree);
+            return;
+        }
+        int subPixelsA = GifSplitPixels(image, numPixels, firstElt, lastElt, splitElt, treeNode, pal);
+        int subPixelsB = numPixels-subPixelsA;
+
+        SplitTopLevels(image,              subPixelsA, firstElt, splitElt, splitElt-splitDist, splitDist/2, treeNode*2,   pal, levels - 1);
+        SplitTopLevels(image+subPixelsA*4, subPixelsB, splitElt, lastElt,  splitElt+splitDist, splitDist/2, treeNode*2+1, pal, levels - 1);
+    }
+
+    // GifThresholdImage applied to a range of pixels on every thread. Afterwards, every thread
+    // copies its range of nextFrame to LastSource for the next frame.
+    void ThresholdImage( const uint8_t* lastFrame, const uint8_t* lastSource, const uint8_t* nextFrame, uint8_t* outFrame, uint32_t numPixels, GifPalette* pPal )
+    {
+        if(UsePaletteLookup && Lookups.empty())
+            for(byte t = 0; t < Pool.TotalThreads; ++t)
+                Lookups.emplace_back(new GifPaletteLookup);
+        Pool.Run([&](const byte threadIndex)
+        {
+            Tracer::NameThread("gif", threadIndex);
+            uint32_t first, end;
+            ThreadRange(threadIndex, numPixels, first, end);
+            GifPaletteLookup* lookup = NULL;
+            if(UsePaletteLookup)
+            {
+                // every frame has its own palette
+                lookup = Lookups[threadIndex].get();
+                GifClearPaletteLookup(lookup);
+            }
+            GifThresholdImage(lastFrame ? lastFrame + first * 4 : NULL, nextFrame + first * 4,
+                outFrame + first * 4, end - first, 1, pPal, lookup, lastSource ? lastSource + first * 4 : NULL);
+            memcpy(LastSource.data() + first * 4, nextFrame + first * 4, (size_t)(end - first) * 4);
+        });
+    }
+
+    // Writes the compressed frames to the file, until count frames are written.
+    void WriteCompressed(const size_t count)
+    {
+        while(Written < count)
+        {
+            Frame &frame = Frames[Written % Frames.size()];
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                CompressedCondition.wait(lock, [&frame] { return frame.Compressed; });
+            }
+            Output->Write(frame.Output.Data(), frame.Output.Size());
+            ++Written;
+        }
+    }
+
+    void CompressorLoop()
+    {
+        // the LZW dictionary of this thread
+        std::vector<GifLzwNode> codetree(4096);
+        for(;;)
+        {
+            Frame *frame;
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                QueuedCondition.wait(lock, [this] { return Stopping || Encoding < Queued; });
+                if(Stopping)
+                    return;
+                frame = &Frames[Encoding++ % Frames.size()];
+            }
+
+            Tracer::NameThread("gif lzw");
+            frame->Output.Clear();
+            GifWriteChangedImage(&frame->Output, frame->Quantized.data(), frame->Width, frame->Height, frame->Delay, &frame->Palette, codetree.data());
+
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                frame->Compressed = true;
+            }
+            CompressedCondition.notify_all();
+        }
+    }
+};
+#endif // GIF_PARALLEL_HPP
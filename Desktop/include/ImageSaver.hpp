@@ -2,26 +2,131 @@
 #define IMAGESAVER_HPP
 
 #include "Vector.hpp"
-#include <fstream>
+#include "OutputSink.hpp"
+#include <string>
+#include <vector>
+#include <memory>
 
+// Savers write RGBA byte images, like Renderer::FrameBuffer, whose alpha channel is ignored.
+// Rows of the image are stride bytes apart, or width * 4 bytes, if stride is 0, so a part of
+// a larger frame can be saved without copying it. The pixels are never modified.
+// An image can also be written in bands of rows from the top (Begin, WriteRows..., End), so
+// it never has to be kept in memory as a whole.
 class ImageSaver
 {
 public:
-    virtual void Save(std::string name, unsigned int width, unsigned int height, Vec3f *pixels) = 0;
+    virtual ~ImageSaver() {}
+    // Extension of the saved files including the dot.
+    virtual const char* Extension() const = 0;
+    // Returns false, if the format cannot store a width x height image.
+    virtual bool CanSave(unsigned int, unsigned int) const { return true; }
+
+    // Writes the header of a width x height image.
+    virtual void Begin(OutputSink &output, unsigned int width, unsigned int height) = 0;
+    // Writes the next rows of the image.
+    virtual void WriteRows(OutputSink &output, const byte *pixels, unsigned int rows, size_t stride) = 0;
+    // Writes whatever follows the last row.
+    virtual void End(OutputSink &) {}
+
+    // Writes the whole image to output, which is not closed.
+    virtual void Write(OutputSink &output, unsigned int width, unsigned int height, const byte *pixels, size_t stride);
+
+    // Saves the image to a file named name with the format's extension. Returns false, if
+    // the file could not be written or the format cannot store the image.
+    bool Save(const std::string &name, unsigned int width, unsigned int height, const byte *pixels, size_t stride = 0);
+    // Saves an image of colors in range [0, 1]. Colors brighter than 1 are scaled down to 1
+    // keeping their hue.
+    bool Save(const std::string &name, unsigned int width, unsigned int height, const Vec3f *pixels);
+
+protected:
+    // Dimensions of the image being written.
+    unsigned int Width, Height;
+    // One row of the output format, reused by every row.
+    std::vector<byte> Row;
 };
 
+// Binary portable pixmap (P6).
 class PPMSaver : public ImageSaver
 {
 public:
-    virtual void Save(std::string name, unsigned int width, unsigned int height, Vec3f *pixels);
+    virtual const char* Extension() const { return ".ppm"; }
+    virtual void Begin(OutputSink &output, unsigned int width, unsigned int height);
+    virtual void WriteRows(OutputSink &output, const byte *pixels, unsigned int rows, size_t stride);
 };
 
+// Headerless RGB bytes, row after row from the top.
+class RawSaver : public ImageSaver
+{
+public:
+    virtual const char* Extension() const { return ".rgb"; }
+    virtual void Begin(OutputSink &output, unsigned int width, unsigned int height);
+    virtual void WriteRows(OutputSink &output, const byte *pixels, unsigned int rows, size_t stride);
+};
+
+// Uncompressed 24-bit bitmap. Whole images are stored from the bottom row as usual, but
+// images written in bands are stored from the top row (with a negative height), so they
+// can be written in order. Sizes in the header have 32 bits, so the pixels must take at most
+// 4 GiB.
 class BMPSaver : public ImageSaver
 {
 private:
-    std::ofstream OutputStream;
-    void WriteBytes(unsigned int value, const unsigned char byteCount);
+    static void WriteBytes(OutputSink &output, unsigned int value, const unsigned char byteCount);
+    // Bytes of the pixels including the padding of the rows.
+    static uint64_t PixelBytes(unsigned int width, unsigned int height);
+    void WriteHeader(OutputSink &output, unsigned int width, unsigned int height, const bool topDown);
+    // Converts a row of pixels to BGR and padding in Row.
+    void ConvertRow(const byte *pixels);
 public:
-    virtual void Save(std::string name, unsigned int width, unsigned int height, Vec3f *pixels);
+    virtual const char* Extension() const { return ".bmp"; }
+    virtual bool CanSave(unsigned int width, unsigned int height) const;
+    virtual void Begin(OutputSink &output, unsigned int width, unsigned int height);
+    virtual void WriteRows(OutputSink &output, const byte *pixels, unsigned int rows, size_t stride);
+    virtual void Write(OutputSink &output, unsigned int width, unsigned int height, const byte *pixels, size_t stride);
+};
+
+// "Quite OK Image" format (https://qoiformat.org), which is lossless, several times smaller
+// than a bitmap and about as fast to write.
+class QOISaver : public ImageSaver
+{
+public:
+    virtual const char* Extension() const { return ".qoi"; }
+    virtual void Begin(OutputSink &output, unsigned int width, unsigned int height);
+    virtual void WriteRows(OutputSink &output, const byte *pixels, unsigned int rows, size_t stride);
+    virtual void End(OutputSink &output);
+
+private:
+    // RGBA colors seen before, indexed by their hash. Like in the decoder, they start as
+    // (0, 0, 0, 0), so black, whose alpha is 255, never matches an unused entry.
+    byte Index[64][4];
+    byte Previous[3];
+    int Run;
+};
+
+// 24-bit PNG, whose pixels are stored in deflate blocks without compression, so it is as
+// large as a bitmap, but can be opened by any program.
+class PNGSaver : public ImageSaver
+{
+public:
+    virtual const char* Extension() const { return ".png"; }
+    virtual void Begin(OutputSink &output, unsigned int width, unsigned int height);
+    virtual void WriteRows(OutputSink &output, const byte *pixels, unsigned int rows, size_t stride);
+    virtual void End(OutputSink &output);
+
+private:
+    // The IDAT chunk being filled with one stored deflate block, and its used bytes.
+    std::vector<byte> Chunk;
+    size_t ChunkUsed;
+    bool FirstChunk;
+    // Adler-32 checksum of the uncompressed data.
+    uint32_t AdlerA, AdlerB;
+
+    static void WriteChunk(OutputSink &output, const char *type, const byte *data, size_t size);
+    // Appends bytes to the zlib stream.
+    void Deflate(OutputSink &output, const byte *data, size_t size);
+    // Writes the current deflate block in an IDAT chunk.
+    void WriteBlock(OutputSink &output, const bool last);
 };
-#endif //IMAGESAVER_HPP
\ No newline at end of file
+// Saver of the format given by the extension of a file named name: ".bmp", ".ppm", ".rgb",
+// ".png" or ".qoi". Returns nullptr for other names.
+std::unique_ptr<ImageSaver> CreateImageSaver(const std::string &name);
+#endif //IMAGESAVER_HPP
@@ -0,0 +1,387 @@
+#ifndef OUTPUTSINK_HPP
+#define OUTPUTSINK_HPP
+
+// Destinations of the bytes written by the image and animation writers. Every sink collects
+// the bytes in a large buffer in user space, so writing single bytes costs no system call
+// and no function call through a pointer.
+// - BufferedFileSink writes the buffer with fwrite whenever it fills up. It works everywhere.
+// - WritevFileSink (POSIX) writes a large block together with the buffered bytes using one
+//   writev call.
+// - MappedFileSink (POSIX) maps the file to memory and copies the bytes straight into it.
+// - MemorySink keeps all bytes in memory.
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OUTPUTSINK_POSIX 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#else
+#define OUTPUTSINK_POSIX 0
+#endif
+
+class OutputSink
+{
+public:
+    OutputSink() : Buffer(NULL), Used(0), Capacity(0), Error(false) {}
+    virtual ~OutputSink() {}
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    void Put(const uint8_t value)
+    {
+        if(Used == Capacity && !Drain(1))
+            return;
+        Buffer[Used++] = value;
+    }
+    void Write(const void *data, const size_t size)
+    {
+        if(size <= Capacity - Used)
+        {
+            memcpy(Buffer + Used, data, size);
+            Used += size;
+        }
+        else
+            WriteLarge((const uint8_t*)data, size);
+    }
+    // Writes the buffered bytes and releases the destination. Returns false, if any byte
+    // could not be written.
+    virtual bool Close() = 0;
+    bool Failed() const { return Error; }
+
+protected:
+    // Bytes [0, Used) of Buffer are written, but not passed to the destination yet.
+    uint8_t *Buffer;
+    size_t Used, Capacity;
+    bool Error;
+
+    // Makes room for at least size more bytes in Buffer. Sets Error and returns false, if it
+    // cannot.
+    virtual bool Drain(const size_t size) = 0;
+    // Writes data, which does not fit in the free part of Buffer.
+    virtual void WriteLarge(const uint8_t *data, size_t size)
+    {
+        while(size > 0)
+        {
+            if(Used == Capacity && !Drain(size))
+                return;
+            const size_t part = std::min(size, Capacity - Used);
+            memcpy(Buffer + Used, data, part);
+            Used += part;
+            data += part;
+            size -= part;
+        }
+    }
+};
+
+
+class BufferedFileSink : public OutputSink
+{
+public:
+    BufferedFileSink(const size_t bufferSize = 1 << 20) : File(NULL), OwnsFile(false), Storage(bufferSize > 0 ? bufferSize : 1)
+    {
+        Buffer = Storage.data();
+        Capacity = Storage.size();
+    }
+    ~BufferedFileSink() { Close(); }
+
+    bool Open(const char *path)
+    {
+        Close();
+        Error = false;
+        File = fopen(path, "wb");
+        if(!File)
+            return false;
+        OwnsFile = true;
+        // the sink buffers on its own
+        setvbuf(File, NULL, _IONBF, 0);
+        return true;
+    }
+    // Writes to the standard output, which is flushed, but not closed by Close.
+    bool OpenStandardOutput()
+    {
+        Close();
+        Error = false;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        File = stdout;
+        OwnsFile = false;
+        return true;
+    }
+    virtual bool Close()
+    {
+        if(!File)
+            return !Error;
+        Flush();
+        if(OwnsFile ? fclose(File) != 0 : fflush(File) != 0)
+            Error = true;
+        File = NULL;
+        return !Error;
+    }
+
+protected:
+    FILE *File;
+    bool OwnsFile;
+    std::vector<uint8_t> Storage;
+
+    void Flush()
+    {
+        if(Used > 0 && fwrite(Buffer, 1, Used, File) != Used)
+            Error = true;
+        Used = 0;
+    }
+    virtual bool Drain(const size_t)
+    {
+        if(!File)
+        {
+            Error = true;
+            return false;
+        }
+        Flush();
+        return !Error;
+    }
+    virtual void WriteLarge(const uint8_t *data, size_t size)
+    {
+        if(!Drain(size))
+            return;
+        if(size < Capacity)
+        {
+            memcpy(Buffer, data, size);
+            Used = size;
+        }
+        else if(fwrite(data, 1, size, File) != size)
+            Error = true;
+    }
+};
+
+
+class MemorySink : public OutputSink
+{
+public:
+    // Forgets the written bytes, but keeps the memory for the next ones.
+    void Clear() { Used = 0; }
+    const uint8_t* Data() const { return Buffer; }
+    size_t Size() const { return Used; }
+    virtual bool Close() { return true; }
+
+protected:
+    std::vector<uint8_t> Storage;
+
+    virtual bool Drain(const size_t size)
+    {
+        Storage.resize(std::max(std::max(2 * Storage.size(), Used + size), (size_t)4096));
+        Buffer = Storage.data();
+        Capacity = Storage.size();
+        return true;
+    }
+};
+
+
+#if OUTPUTSINK_POSIX
+class WritevFileSink : public OutputSink
+{
+public:
+    WritevFileSink(const size_t bufferSize = 1 << 20) : Descriptor(-1), Storage(bufferSize > 0 ? bufferSize : 1)
+    {
+        Buffer = Storage.data();
+        Capacity = Storage.size();
+    }
+    ~WritevFileSink() { Close(); }
+
+    bool Open(const char *path)
+    {
+        Close();
+        Error = false;
+        Descriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        return Descriptor >= 0;
+    }
+    virtual bool Close()
+    {
+        if(Descriptor < 0)
+            return !Error;
+        WriteAll(NULL, 0);
+        if(close(Descriptor) != 0)
+            Error = true;
+        Descriptor = -1;
+        return !Error;
+    }
+
+protected:
+    int Descriptor;
+    std::vector<uint8_t> Storage;
+
+    // Writes the buffered bytes followed by data with as few writev calls as possible.
+    void WriteAll(const uint8_t *data, size_t size)
+    {
+        iovec parts[2] = { { Buffer, Used }, { (void*)data, size } };
+        int first = 0;
+        while(first < 2 && (parts[first].iov_len > 0 || (first == 0 && size > 0)))
+        {
+            const ssize_t written = writev(Descriptor, parts + first, 2 - first);
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                Error = true;
+                break;
+            }
+            size_t remaining = (size_t)written;
+            while(first < 2 && remaining >= parts[first].iov_len)
+                remaining -= parts[first++].iov_len;
+            if(first < 2)
+            {
+                parts[first].iov_base = (uint8_t*)parts[first].iov_base + remaining;
+                parts[first].iov_len -= remaining;
+            }
+        }
+        Used = 0;
+    }
+    virtual bool Drain(const size_t)
+    {
+        if(Descriptor < 0)
+        {
+            Error = true;
+            return false;
+        }
+        WriteAll(NULL, 0);
+        return !Error;
+    }
+    virtual void WriteLarge(const uint8_t *data, size_t size)
+    {
+        if(Descriptor < 0)
+            Error = true;
+        else
+            WriteAll(data, size);
+    }
+};
+
+
+class MappedFileSink : public OutputSink
+{
+public:
+    MappedFileSink(const size_t initialSize = 1 << 22) : Descriptor(-1), InitialSize(initialSize > 0 ? initialSize : 1) {}
+    ~MappedFileSink() { Close(); }
+
+    bool Open(const char *path)
+    {
+        Close();
+        Error = false;
+        Descriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(Descriptor < 0)
+            return false;
+        Used = 0;
+        return Map(InitialSize);
+    }
+    // Cuts the file to the written bytes.
+    virtual bool Close()
+    {
+        if(Descriptor < 0)
+            return !Error;
+        Unmap();
+        if(ftruncate(Descriptor, (off_t)Used) != 0)
+            Error = true;
+        if(close(Descriptor) != 0)
+            Error = true;
+        Descriptor = -1;
+        Used = 0;
+        return !Error;
+    }
+
+protected:
+    int Descriptor;
+    const size_t InitialSize;
+
+    bool Map(const size_t size)
+    {
+        if(ftruncate(Descriptor, (off_t)size) != 0)
+        {
+            Error = true;
+            return false;
+        }
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, Descriptor, 0);
+        if(memory == MAP_FAILED)
+        {
+            Error = true;
+            return false;
+        }
+        Buffer = (uint8_t*)memory;
+        Capacity = size;
+        return true;
+    }
+    void Unmap()
+    {
+        if(Buffer)
+            munmap(Buffer, Capacity);
+        Buffer = NULL;
+        Capacity = 0;
+    }
+    // The file grows at least twice, so the mapping is remade only a few times.
+    virtual bool Drain(const size_t size)
+    {
+        if(Descriptor < 0)
+        {
+            Error = true;
+            return false;
+        }
+        const size_t newSize = std::max(2 * Capacity, Used + size);
+        Unmap();
+        return Map(newSize);
+    }
+};
+#endif // OUTPUTSINK_POSIX
+
+enum class OutputSinkType { Buffered, Writev, Mapped };
+
+// Opens a file sink of the given type, or a BufferedFileSink, if the type is not available
+// on this platform or for this file (e.g. a named pipe cannot be mapped). Path "-" is the
+// standard output. Returns nullptr, if the file cannot be opened.
+inline std::unique_ptr<OutputSink> OpenOutputSink(const char *path, const OutputSinkType type = OutputSinkType::Buffered)
+{
+    if(strcmp(path, "-") == 0)
+    {
+        std::unique_ptr<BufferedFileSink> sink(new BufferedFileSink);
+        sink->OpenStandardOutput();
+        return sink;
+    }
+#if OUTPUTSINK_POSIX
+    if(type == OutputSinkType::Writev)
+    {
+        std::unique_ptr<WritevFileSink> sink(new WritevFileSink);
+        if(!sink->Open(path)) return nullptr;
+        return sink;
+    }
+    if(type == OutputSinkType::Mapped)
+    {
+        std::unique_ptr<MappedFileSink> sink(new MappedFileSink);
+        if(sink->Open(path)) return sink;
+    }
+#endif
+    std::unique_ptr<BufferedFileSink> sink(new BufferedFileSink);
+    if(!sink->Open(path)) return nullptr;
+    return sink;
+}
+
+// Writes text formatted like by printf to output. Texts longer than 255 characters are cut.
+template<class... Arguments>
+inline void Print(OutputSink &output, const char *format, Arguments... arguments)
+{
+    char text[256];
+    const int length = snprintf(text, sizeof(text), format, arguments...);
+    if(length > 0)
+        output.Write(text, std::min((size_t)length, sizeof(text) - 1));
+}
+#endif // OUTPUTSINK_HPP
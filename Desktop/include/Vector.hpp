@@ -1,12 +1,35 @@
 #ifndef VECTOR_HPP
 #define VECTOR_HPP
 
+// The whole vector library is defined in this header, so every call can be inlined into
+// the code, which uses it.
+
 #include <iostream>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <stdint.h>
+
+// 4-wide SIMD types (Float4, Vec3f4) are available, if the target has SSE2 intrinsics.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECTOR_SIMD 1
+#include <emmintrin.h>
+#else
+#define VECTOR_SIMD 0
+#endif
+
+// Accuracy switch for normalization. If set to 1 before including this header, Normalize
+// multiplies by an approximate reciprocal square root (relative error about 1e-7 after one
+// Newton-Raphson step) instead of dividing by the exact norm. Off by default, because it
+// changes the rendered images slightly.
+#ifndef VECTOR_FAST_RSQRT
+#define VECTOR_FAST_RSQRT 0
+#endif
 
 struct Vec4f
 {
     float X, Y, Z, W;
-    Vec4f(const float x = 0, const float y = 0, const float z = 0, const float w = 0);
+    constexpr Vec4f(const float x = 0, const float y = 0, const float z = 0, const float w = 0);
     float& operator[](const size_t i);
     const float& operator[](const size_t i) const;
 };
@@ -16,7 +39,7 @@ typedef uint8_t byte;
 struct Vec3b
 {
     byte R, G, B;
-    Vec3b(const byte r = 0, const byte g = 0, const byte b = 0);
+    constexpr Vec3b(const byte r = 0, const byte g = 0, const byte b = 0);
     byte& operator[](const size_t i);
     const byte& operator[](const size_t i) const;
 };
@@ -25,11 +48,11 @@ struct Vec3b
 struct Vec3f
 {
     float X, Y, Z;
-    Vec3f(const float x = 0, const float y = 0, const float z = 0);
+    constexpr Vec3f(const float x = 0, const float y = 0, const float z = 0);
     float& operator[](const size_t i);
     const float& operator[](const size_t i) const;
-    Vec3f& operator+=(const Vec3f &v);
-    static Vec3f Cross(const Vec3f &v1, const Vec3f &v2); // cross product
+    constexpr Vec3f& operator+=(const Vec3f &v);
+    static constexpr Vec3f Cross(const Vec3f &v1, const Vec3f &v2); // cross product
     float Norm() const;
     Vec3f& Normalize();
     float NormalizeReturnNorm();
@@ -41,17 +64,321 @@ struct Vec3f
     void RotateZ(const float sinA, const float cosA);
     void RotateAxisMatrix(const Vec3f &axis, const float angle);
     void RotateAxisQuaternion(const Vec3f &axis, const float angle);
-    operator Vec3b() const;
+    constexpr operator Vec3b() const;
 };
 
-float operator*(const Vec3f &v1, const Vec3f &v2); // dot product
-Vec3f operator+(Vec3f v1, const Vec3f &v2);
-Vec3f operator-(Vec3f v1, const Vec3f &v2);
-Vec3f operator*(const Vec3f &v, const float factor);
-Vec3f operator*(const float factor, const Vec3f &v);
-Vec3f operator-(const Vec3f &v);
+constexpr float operator*(const Vec3f &v1, const Vec3f &v2); // dot product
+constexpr Vec3f operator+(Vec3f v1, const Vec3f &v2);
+constexpr Vec3f operator-(Vec3f v1, const Vec3f &v2);
+constexpr Vec3f operator*(const Vec3f &v, const float factor);
+constexpr Vec3f operator*(const float factor, const Vec3f &v);
+constexpr Vec3f operator-(const Vec3f &v);
 std::ostream& operator<<(std::ostream &out, const Vec3f &v);
 
-Vec3f reflect(const Vec3f &I, const Vec3f &N);
+constexpr Vec3f reflect(const Vec3f &I, const Vec3f &N);
 Vec3f refract(const Vec3f &I, const Vec3f &N, const float eta_t, const float eta_i=1.f);
-#endif //VECTOR_HPP
\ No newline at end of file
+// Same as refract, but returns false instead of a made-up direction on total internal reflection.
+bool TryRefract(const Vec3f &I, const Vec3f &N, const float eta_t, const float eta_i, Vec3f &refracted);
+
+// Components are indexed as an array, which requires them to be laid out without padding.
+static_assert(sizeof(Vec3f) == 3 * sizeof(float), "Vec3f must be tightly packed");
+static_assert(sizeof(Vec4f) == 4 * sizeof(float), "Vec4f must be tightly packed");
+static_assert(sizeof(Vec3b) == 3, "Vec3b must be tightly packed");
+
+// 1 / sqrt(f), approximated if VECTOR_FAST_RSQRT is set.
+inline float ReciprocalSqrt(const float f)
+{
+#if VECTOR_FAST_RSQRT && VECTOR_SIMD
+    const float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(f)));
+    return r * (1.5f - 0.5f * f * r * r); // one Newton-Raphson step
+#else
+    return 1.f / sqrtf(f);
+#endif
+}
+
+
+constexpr Vec3f::Vec3f(const float x, const float y, const float z) : X(x), Y(y), Z(z) {}
+
+inline float& Vec3f::operator[](const size_t i)
+{
+    assert(i < 3); return (&X)[i];
+}
+inline const float& Vec3f::operator[](const size_t i) const
+{
+    assert(i < 3); return (&X)[i];
+}
+constexpr Vec3f& Vec3f::operator+=(const Vec3f &v)
+{
+    X += v.X;
+    Y += v.Y;
+    Z += v.Z;
+    return *this;
+}
+constexpr Vec3f Vec3f::Cross(const Vec3f &v1, const Vec3f &v2)
+{
+    return Vec3f(v1.Y*v2.Z - v1.Z*v2.Y, v1.Z*v2.X - v1.X*v2.Z, v1.X*v2.Y - v1.Y*v2.X);
+}
+inline float Vec3f::Norm() const
+{
+    return sqrtf(X*X + Y*Y + Z*Z);
+}
+inline Vec3f& Vec3f::Normalize()
+{
+#if VECTOR_FAST_RSQRT
+    const float inverseNorm = ReciprocalSqrt(X*X + Y*Y + Z*Z);
+    X *= inverseNorm;
+    Y *= inverseNorm;
+    Z *= inverseNorm;
+#else
+    const float norm = Norm();
+    X /= norm;
+    Y /= norm;
+    Z /= norm;
+#endif
+    return *this;
+}
+inline float Vec3f::NormalizeReturnNorm()
+{
+#if VECTOR_FAST_RSQRT
+    const float squaredNorm = X*X + Y*Y + Z*Z, inverseNorm = ReciprocalSqrt(squaredNorm);
+    X *= inverseNorm;
+    Y *= inverseNorm;
+    Z *= inverseNorm;
+    return squaredNorm * inverseNorm;
+#else
+    const float norm = Norm();
+    X /= norm;
+    Y /= norm;
+    Z /= norm;
+    return norm;
+#endif
+}
+constexpr Vec3f reflect(const Vec3f &I, const Vec3f &N)
+{
+    /* Rotation of I vector by 180 degrees around N vector using quaternion.
+    qr = cos(180/2) = 0, s = sin(180/2) = 1
+    qxyz = (N.X * 1, N.Y * 1, N.Z * 1) = N
+    |N| = |I| = 1
+    I' = 2.0f * (N*I) * N + (0 - (N*N)) * I = 2.0f * (N*I) * N + (0 - (1^2)) * I = 2.0f * (N*I) * N - I
+    The rotated I' vector is still pointing at the point, where the ray hit, so it has to be inversed in order to be fully reflected.
+    result - -I' = I - 2.0f * (N*I) * N */
+    return I - N*2.f*(I*N);
+}
+inline bool TryRefract(const Vec3f &I, const Vec3f &N, const float eta_t, const float eta_i, Vec3f &refracted)
+{ // Snell's law
+    float cosi = - std::max(-1.f, std::min(1.f, I*N));
+    if (cosi<0) return TryRefract(I, -N, eta_i, eta_t, refracted); // if the ray comes from the inside the object, swap the air and the media
+    float eta = eta_i / eta_t;
+    float k = 1 - eta*eta*(1 - cosi*cosi);
+    if (k<0) return false; // total reflection, no ray to refract
+    refracted = I*eta + N*(eta*cosi - sqrtf(k));
+    return true;
+}
+inline Vec3f refract(const Vec3f &I, const Vec3f &N, const float eta_t, const float eta_i)
+{
+    Vec3f refracted;
+    // On total reflection, refract it anyways. This has no physical meaning.
+    return TryRefract(I, N, eta_t, eta_i, refracted) ? refracted : Vec3f(1,0,0);
+}
+inline void Vec3f::RotateX(const float angle) { RotateX(sin(angle), cos(angle)); }
+inline void Vec3f::RotateX(const float sinA, const float cosA)
+{
+    const float y = Y, z = Z;
+    Y = y * cosA - z * sinA;
+    Z = y * sinA + z * cosA;
+}
+inline void Vec3f::RotateY(const float angle) { RotateY(sin(angle), cos(angle)); }
+inline void Vec3f::RotateY(const float sinA, const float cosA)
+{
+    const float x = X, z = Z;
+    X = x * cosA + z * sinA;
+    Z = -x * sinA + z * cosA;
+}
+inline void Vec3f::RotateZ(const float angle) { RotateZ(sin(angle), cos(angle)); }
+inline void Vec3f::RotateZ(const float sinA, const float cosA)
+{
+    const float x = X, y = Y;
+    X = x * cosA - y * sinA;
+    Y = x * sinA + y * cosA;
+}
+inline void Vec3f::RotateAxisMatrix(const Vec3f &axis, const float angle)
+{
+    // https://www.continuummechanics.org/rotationmatrix.html
+    float vx = X, vy = Y, vz = Z, c = cos(angle), s = sin(angle);
+    X = (c + (1 - c)*axis.X*axis.X)*vx +        ((1 - c)*axis.X*axis.Y - s*axis.Z)*vy +	((1 - c)*axis.X*axis.Z + s*axis.Y)*vz;
+    Y = ((1 - c)*axis.X*axis.Y + s*axis.Z)*vx +	(c + (1 - c)*axis.Y*axis.Y)*vy +		((1 - c)*axis.Y*axis.Z - s*axis.X)*vz;
+	Z = ((1 - c)*axis.X*axis.Z - s*axis.Y)*vx +	((1 - c)*axis.Y*axis.Z + s*axis.X)*vy +	(c + (1 - c)*axis.Z*axis.Z)*vz;
+}
+inline void Vec3f::RotateAxisQuaternion(const Vec3f &axis, const float angle)
+{
+    // https://en.wikipedia.org/wiki/Quaternions_and_spatial_rotation
+    // q = cos(angle/2) + (axis.x*i + axis.y*j + axis.z*k)*sin(angle/2)
+    const float qr = cos(angle / 2.f), s = sin(angle / 2.f);
+    Vec3f qxyz(axis.X * s, axis.Y * s, axis.Z * s);
+
+    // https://gamedev.stackexchange.com/questions/28395/rotating-vector3-by-a-quaternion
+    *this = 2.0f * (qxyz*(*this)) * qxyz
+          + (qr*qr - (qxyz*qxyz)) * (*this)
+          + 2.0f * qr * Cross(qxyz, *this);
+}
+constexpr Vec3f::operator Vec3b() const
+{
+    return Vec3b(X > 1.f ? 255 : (byte)(255 * X),
+                 Y > 1.f ? 255 : (byte)(255 * Y),
+                 Z > 1.f ? 255 : (byte)(255 * Z));
+}
+
+constexpr float operator*(const Vec3f &v1, const Vec3f &v2)
+{
+    return v1.X * v2.X + v1.Y * v2.Y + v1.Z * v2.Z;
+}
+
+constexpr Vec3f operator+(Vec3f v1, const Vec3f &v2)
+{
+    v1.X += v2.X;
+    v1.Y += v2.Y;
+    v1.Z += v2.Z;
+    return v1;
+}
+
+constexpr Vec3f operator-(Vec3f v1, const Vec3f &v2)
+{
+    v1.X -= v2.X;
+    v1.Y -= v2.Y;
+    v1.Z -= v2.Z;
+    return v1;
+}
+
+constexpr Vec3f operator*(const Vec3f &v, const float factor)
+{
+    return Vec3f(v.X * factor, v.Y * factor, v.Z * factor);
+}
+
+constexpr Vec3f operator*(const float factor, const Vec3f &v)
+{
+    return v * factor;
+}
+
+constexpr Vec3f operator-(const Vec3f &v)
+{
+    return v * -1.f;
+}
+
+inline std::ostream& operator<<(std::ostream &out, const Vec3f &v)
+{
+    out << v.X << ' ' << v.Y << ' ' << v.Z;
+    return out;
+}
+
+
+constexpr Vec3b::Vec3b(const byte r, const byte g, const byte b) : R(r), G(g), B(b) {}
+
+inline byte& Vec3b::operator[](const size_t i)
+{
+    assert(i < 3); return (&R)[i];
+}
+inline const byte& Vec3b::operator[](const size_t i) const
+{
+    assert(i < 3); return (&R)[i];
+}
+
+
+constexpr Vec4f::Vec4f(const float x, const float y, const float z, const float w) : X(x), Y(y), Z(z), W(w) {}
+
+inline float& Vec4f::operator[](const size_t i)
+{
+    assert(i < 4); return (&X)[i];
+}
+inline const float& Vec4f::operator[](const size_t i) const
+{
+    assert(i < 4); return (&X)[i];
+}
+
+
+#if VECTOR_SIMD
+// 4 floats processed by every operation at once. Comparisons return masks with all bits
+// of a lane set, if the comparison holds for that lane.
+struct Float4
+{
+    __m128 V;
+
+    Float4() {}
+    Float4(const __m128 v) : V(v) {}
+    Float4(const float f) : V(_mm_set1_ps(f)) {}
+    static Float4 Load(const float *p) { return _mm_loadu_ps(p); }
+    void Store(float *p) const { _mm_storeu_ps(p, V); }
+};
+inline Float4 operator+(const Float4 &a, const Float4 &b) { return _mm_add_ps(a.V, b.V); }
+inline Float4 operator-(const Float4 &a, const Float4 &b) { return _mm_sub_ps(a.V, b.V); }
+inline Float4 operator*(const Float4 &a, const Float4 &b) { return _mm_mul_ps(a.V, b.V); }
+inline Float4 operator/(const Float4 &a, const Float4 &b) { return _mm_div_ps(a.V, b.V); }
+inline Float4 operator<(const Float4 &a, const Float4 &b) { return _mm_cmplt_ps(a.V, b.V); }
+inline Float4 operator<=(const Float4 &a, const Float4 &b) { return _mm_cmple_ps(a.V, b.V); }
+inline Float4 operator>(const Float4 &a, const Float4 &b) { return _mm_cmpgt_ps(a.V, b.V); }
+inline Float4 operator>=(const Float4 &a, const Float4 &b) { return _mm_cmpge_ps(a.V, b.V); }
+inline Float4 operator&(const Float4 &a, const Float4 &b) { return _mm_and_ps(a.V, b.V); }
+inline Float4 operator|(const Float4 &a, const Float4 &b) { return _mm_or_ps(a.V, b.V); }
+inline Float4 Min(const Float4 &a, const Float4 &b) { return _mm_min_ps(a.V, b.V); }
+inline Float4 Max(const Float4 &a, const Float4 &b) { return _mm_max_ps(a.V, b.V); }
+inline Float4 Sqrt(const Float4 &a) { return _mm_sqrt_ps(a.V); }
+// 1 / sqrt(a), approximated if VECTOR_FAST_RSQRT is set.
+inline Float4 ReciprocalSqrt(const Float4 &a)
+{
+#if VECTOR_FAST_RSQRT
+    const Float4 r = _mm_rsqrt_ps(a.V);
+    return r * (Float4(1.5f) - Float4(0.5f) * a * r * r); // one Newton-Raphson step
+#else
+    return Float4(1.f) / Sqrt(a);
+#endif
+}
+// a where mask is set, b elsewhere
+inline Float4 Select(const Float4 &mask, const Float4 &a, const Float4 &b)
+{
+    return _mm_or_ps(_mm_and_ps(mask.V, a.V), _mm_andnot_ps(mask.V, b.V));
+}
+inline bool Any(const Float4 &mask) { return _mm_movemask_ps(mask.V) != 0; }
+
+// 4 vectors stored as structure of arrays, so every operation works on all of them at once.
+struct Vec3f4
+{
+    Float4 X, Y, Z;
+
+    Vec3f4() {}
+    Vec3f4(const Float4 &x, const Float4 &y, const Float4 &z) : X(x), Y(y), Z(z) {}
+    // the same vector in all 4 lanes
+    Vec3f4(const Vec3f &v) : X(v.X), Y(v.Y), Z(v.Z) {}
+    Vec3f4& Normalize()
+    {
+#if VECTOR_FAST_RSQRT
+        const Float4 inverseNorm = ReciprocalSqrt(X*X + Y*Y + Z*Z);
+        X = X * inverseNorm;
+        Y = Y * inverseNorm;
+        Z = Z * inverseNorm;
+#else
+        const Float4 norm = Sqrt(X*X + Y*Y + Z*Z);
+        X = X / norm;
+        Y = Y / norm;
+        Z = Z / norm;
+#endif
+        return *this;
+    }
+    // Vector of lane i.
+    Vec3f Lane(const int i) const
+    {
+        float x[4], y[4], z[4];
+        X.Store(x);
+        Y.Store(y);
+        Z.Store(z);
+        return Vec3f(x[i], y[i], z[i]);
+    }
+};
+inline Float4 operator*(const Vec3f4 &v1, const Vec3f4 &v2) // dot product
+{
+    return v1.X * v2.X + v1.Y * v2.Y + v1.Z * v2.Z;
+}
+inline Vec3f4 operator+(const Vec3f4 &v1, const Vec3f4 &v2) { return Vec3f4(v1.X + v2.X, v1.Y + v2.Y, v1.Z + v2.Z); }
+inline Vec3f4 operator-(const Vec3f4 &v1, const Vec3f4 &v2) { return Vec3f4(v1.X - v2.X, v1.Y - v2.Y, v1.Z - v2.Z); }
+inline Vec3f4 operator*(const Vec3f4 &v, const Float4 &factor) { return Vec3f4(v.X * factor, v.Y * factor, v.Z * factor); }
+inline Vec3f4 operator*(const Float4 &factor, const Vec3f4 &v) { return v * factor; }
+#endif // VECTOR_SIMD
+#endif //VECTOR_HPP
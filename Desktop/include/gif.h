@@ -36,8 +36,8 @@
 // Define these macros to hook into a custom memory allocator.
 // TEMP_MALLOC and TEMP_FREE will only be called in stack fashion - frees in the reverse order of mallocs
 // and any temp memory allocated by a function will be freed before it exits.
-// MALLOC and FREE are used only by GifBegin and GifEnd respectively (to allocate a buffer the size of the image, which
-// is used to find changed pixels for delta-encoding.)
+// MALLOC and FREE are used only by GifBegin and GifEnd respectively (to allocate buffers the size of the image, which
+// are used to find changed pixels for delta-encoding, and the scratch memory reused by every frame.)
 
 #ifndef GIF_TEMP_MALLOC
 #include <stdlib.h>
@@ -59,6 +59,12 @@
 #define GIF_FREE free
 #endif
 
+// Define this macro to time the main steps of writing a frame (making the palette, thresholding
+// and LZW-compressing the image), e.g. as a scoped object, which records a span named name.
+#ifndef GIF_TRACE_SCOPE
+#define GIF_TRACE_SCOPE(name)
+#endif
+
 const int kGifTransIndex = 0;
 
 struct GifPalette
@@ -133,6 +139,42 @@ void GifGetClosestPaletteColor(GifPalette* pPal, int r, int g, int b, int& bestI
     }
 }
 
+// Nearest palette colors cached over a 64x64x64 grid of RGB space, so matching a pixel is
+// usually a table read instead of a tree walk. All colors in a grid cell are matched as the
+// color at the cell's center, so the result may be a slightly worse match than the one found
+// by GifGetClosestPaletteColor. Entries are filled lazily. An entry equal to kGifTransIndex
+// is not filled yet, because the transparency index is never picked.
+// The cache is only valid for one palette and must be cleared before it is used with another.
+const int kGifLookupBits = 6;
+struct GifPaletteLookup
+{
+    uint8_t index[1 << (3*kGifLookupBits)];
+};
+
+void GifClearPaletteLookup(GifPaletteLookup* pLookup)
+{
+    memset(pLookup->index, kGifTransIndex, sizeof(pLookup->index));
+}
+
+// Returns the palette entry for a desired color, walking the k-d tree only the first time
+// a color from the same grid cell is looked up.
+int GifLookupPaletteColor(GifPalette* pPal, GifPaletteLookup* pLookup, int r, int g, int b)
+{
+    const int shift = 8 - kGifLookupBits;
+    const int cell = ((r >> shift) << (2*kGifLookupBits)) | ((g >> shift) << kGifLookupBits) | (b >> shift);
+    int ind = pLookup->index[cell];
+    if(ind == kGifTransIndex)
+    {
+        const int center = 1 << (shift-1);
+        int bestDiff = 1000000;
+        ind = 1;
+        GifGetClosestPaletteColor(pPal, ((r >> shift) << shift) + center, ((g >> shift) << shift) + center,
+            ((b >> shift) << shift) + center, ind, bestDiff);
+        pLookup->index[cell] = (uint8_t)ind;
+    }
+    return ind;
+}
+
 void GifSwapPixels(uint8_t* image, int pixA, int pixB)
 {
     uint8_t rA = image[pixA*4];
@@ -203,6 +245,8 @@ void GifPartitionByMedian(uint8_t* image, int left, int right, int com, int need
     }
 }
 
+int GifSplitPixels(uint8_t* image, int numPixels, int firstElt, int lastElt, int splitElt, int treeNode, GifPalette* pal);
+
 // Builds a palette by creating a balanced k-d tree of all pixels in the image
 void GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt, int splitElt, int splitDist, int treeNode, bool buildForDither, GifPalette* pal)
 {
@@ -278,6 +322,17 @@ void GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt, i
         return;
     }
 
+    int subPixelsA = GifSplitPixels(image, numPixels, firstElt, lastElt, splitElt, treeNode, pal);
+    int subPixelsB = numPixels-subPixelsA;
+
+    GifSplitPalette(image,              subPixelsA, firstElt, splitElt, splitElt-splitDist, splitDist/2, treeNode*2,   buildForDither, pal);
+    GifSplitPalette(image+subPixelsA*4, subPixelsB, splitElt, lastElt,  splitElt+splitDist, splitDist/2, treeNode*2+1, buildForDither, pal);
+}
+
+// Splits the pixels of an inner node of the palette's k-d tree along the axis with the largest
+// range and records the split in the tree. Returns the number of pixels, which go to the first child.
+int GifSplitPixels(uint8_t* image, int numPixels, int firstElt, int lastElt, int splitElt, int treeNode, GifPalette* pal)
+{
     // Find the axis with the largest range
     int minR = 255, maxR = 0;
     int minG = 255, maxG = 0;
@@ -308,15 +363,13 @@ void GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt, i
     if(rRange > bRange && rRange > gRange) splitCom = 0;
 
     int subPixelsA = numPixels * (splitElt - firstElt) / (lastElt - firstElt);
-    int subPixelsB = numPixels-subPixelsA;
 
     GifPartitionByMedian(image, 0, numPixels, splitCom, subPixelsA);
 
     pal->treeSplitElt[treeNode] = (uint8_t)splitCom;
     pal->treeSplit[treeNode] = image[subPixelsA*4+splitCom];
 
-    GifSplitPalette(image,              subPixelsA, firstElt, splitElt, splitElt-splitDist, splitDist/2, treeNode*2,   buildForDither, pal);
-    GifSplitPalette(image+subPixelsA*4, subPixelsB, splitElt, lastElt,  splitElt+splitDist, splitDist/2, treeNode*2+1, buildForDither, pal);
+    return subPixelsA;
 }
 
 // Finds all pixels that have changed from the previous image and
@@ -349,14 +402,19 @@ int GifPickChangedPixels( const uint8_t* lastFrame, uint8_t* frame, int numPixel
 
 // Creates a palette by placing all the image pixels in a k-d tree and then averaging the blocks at the bottom.
 // This is known as the "modified median split" technique
-void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_t width, uint32_t height, int bitDepth, bool buildForDither, GifPalette* pPal )
+// If scratch (width*height*4 bytes) is given, it is used instead of temporary memory.
+void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_t width, uint32_t height, int bitDepth, bool buildForDither, GifPalette* pPal, uint8_t* scratch = NULL )
 {
+    GIF_TRACE_SCOPE("GifMakePalette");
+    // with few changed pixels, most entries are not set by GifSplitPalette, but they are
+    // still written to the file
+    memset(pPal, 0, sizeof(*pPal));
     pPal->bitDepth = bitDepth;
 
     // SplitPalette is destructive (it sorts the pixels by color) so
     // we must create a copy of the image for it to destroy
     size_t imageSize = (size_t)(width * height * 4 * sizeof(uint8_t));
-    uint8_t* destroyableImage = (uint8_t*)GIF_TEMP_MALLOC(imageSize);
+    uint8_t* destroyableImage = scratch? scratch : (uint8_t*)GIF_TEMP_MALLOC(imageSize);
     memcpy(destroyableImage, nextFrame, imageSize);
 
     int numPixels = (int)(width * height);
@@ -369,7 +427,7 @@ void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_
 
     GifSplitPalette(destroyableImage, numPixels, 1, lastElt, splitElt, splitDist, 1, buildForDither, pPal);
 
-    GIF_TEMP_FREE(destroyableImage);
+    if(!scratch) GIF_TEMP_FREE(destroyableImage);
 
     // add the bottom node for the transparency index
     pPal->treeSplit[1 << (bitDepth-1)] = 0;
@@ -379,14 +437,15 @@ void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_
 }
 
 // Implements Floyd-Steinberg dithering, writes palette value to alpha
-void GifDitherImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t* outFrame, uint32_t width, uint32_t height, GifPalette* pPal )
+// If scratch (width*height*4 integers) is given, it is used instead of temporary memory.
+void GifDitherImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t* outFrame, uint32_t width, uint32_t height, GifPalette* pPal, int32_t* scratch = NULL )
 {
     int numPixels = (int)(width * height);
 
     // quantPixels initially holds color*256 for all pixels
     // The extra 8 bits of precision allow for sub-single-color error values
     // to be propagated
-    int32_t *quantPixels = (int32_t *)GIF_TEMP_MALLOC(sizeof(int32_t) * (size_t)numPixels * 4);
+    int32_t *quantPixels = scratch? scratch : (int32_t *)GIF_TEMP_MALLOC(sizeof(int32_t) * (size_t)numPixels * 4);
 
     for( int ii=0; ii<numPixels*4; ++ii )
     {
@@ -484,21 +543,27 @@ void GifDitherImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t
         outFrame[ii] = (uint8_t)quantPixels[ii];
     }
 
-    GIF_TEMP_FREE(quantPixels);
+    if(!scratch) GIF_TEMP_FREE(quantPixels);
 }
 
 // Picks palette colors for the image using simple thresholding, no dithering
-void GifThresholdImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t* outFrame, uint32_t width, uint32_t height, GifPalette* pPal )
+// If pLookup is given, palette colors are looked up in it instead of the k-d tree.
+// If lastSource, the previous frame before quantization, is given, the current colors are
+// compared with it instead of the quantized lastFrame, so unchanged pixels stay transparent,
+// even if their colors are not in the palette.
+void GifThresholdImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t* outFrame, uint32_t width, uint32_t height, GifPalette* pPal, GifPaletteLookup* pLookup = NULL, const uint8_t* lastSource = NULL )
 {
+    GIF_TRACE_SCOPE("GifThresholdImage");
     uint32_t numPixels = width*height;
     for( uint32_t ii=0; ii<numPixels; ++ii )
     {
         // if a previous color is available, and it matches the current color,
         // set the pixel to transparent
+        const uint8_t* lastColor = lastSource? lastSource : lastFrame;
         if(lastFrame &&
-           lastFrame[0] == nextFrame[0] &&
-           lastFrame[1] == nextFrame[1] &&
-           lastFrame[2] == nextFrame[2])
+           lastColor[0] == nextFrame[0] &&
+           lastColor[1] == nextFrame[1] &&
+           lastColor[2] == nextFrame[2])
         {
             outFrame[0] = lastFrame[0];
             outFrame[1] = lastFrame[1];
@@ -510,7 +575,10 @@ void GifThresholdImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint
             // palettize the pixel
             int32_t bestDiff = 1000000;
             int32_t bestInd = 1;
-            GifGetClosestPaletteColor(pPal, nextFrame[0], nextFrame[1], nextFrame[2], bestInd, bestDiff);
+            if(pLookup)
+                bestInd = GifLookupPaletteColor(pPal, pLookup, nextFrame[0], nextFrame[1], nextFrame[2]);
+            else
+                GifGetClosestPaletteColor(pPal, nextFrame[0], nextFrame[1], nextFrame[2], bestInd, bestDiff);
 
             // Write the resulting color to the output buffer
             outFrame[0] = pPal->r[bestInd];
@@ -520,11 +588,17 @@ void GifThresholdImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint
         }
 
         if(lastFrame) lastFrame += 4;
+        if(lastSource) lastSource += 4;
         outFrame += 4;
         nextFrame += 4;
     }
 }
 
+// The functions writing the file are templates over their output, so they can write to memory
+// as well as to a FILE*. Any other output type needs its own GifPutc and GifPutBytes overloads.
+inline void GifPutc( FILE* f, int c ) { fputc(c, f); }
+inline void GifPutBytes( FILE* f, const void* data, size_t size ) { fwrite(data, 1, size, f); }
+
 // Simple structure to write out the LZW-compressed portion of the image
 // one bit at a time
 struct GifBitStatus
@@ -555,17 +629,19 @@ void GifWriteBit( GifBitStatus& stat, uint32_t bit )
 }
 
 // write all bytes so far to the file
-void GifWriteChunk( FILE* f, GifBitStatus& stat )
+template<class Output>
+void GifWriteChunk( Output* f, GifBitStatus& stat )
 {
-    fputc((int)stat.chunkIndex, f);
-    fwrite(stat.chunk, 1, stat.chunkIndex, f);
+    GifPutc(f, (int)stat.chunkIndex);
+    GifPutBytes(f, stat.chunk, stat.chunkIndex);
 
     stat.bitIndex = 0;
     stat.byte = 0;
     stat.chunkIndex = 0;
 }
 
-void GifWriteCode( FILE* f, GifBitStatus& stat, uint32_t code, uint32_t length )
+template<class Output>
+void GifWriteCode( Output* f, GifBitStatus& stat, uint32_t code, uint32_t length )
 {
     for( uint32_t ii=0; ii<length; ++ii )
     {
@@ -587,11 +663,12 @@ struct GifLzwNode
 };
 
 // write a 256-color (8-bit) image palette to the file
-void GifWritePalette( const GifPalette* pPal, FILE* f )
+template<class Output>
+void GifWritePalette( const GifPalette* pPal, Output* f )
 {
-    fputc(0, f);  // first color: transparency
-    fputc(0, f);
-    fputc(0, f);
+    GifPutc(f, 0);  // first color: transparency
+    GifPutc(f, 0);
+    GifPutc(f, 0);
 
     for(int ii=1; ii<(1 << pPal->bitDepth); ++ii)
     {
@@ -599,49 +676,57 @@ void GifWritePalette( const GifPalette* pPal, FILE* f )
         uint32_t g = pPal->g[ii];
         uint32_t b = pPal->b[ii];
 
-        fputc((int)r, f);
-        fputc((int)g, f);
-        fputc((int)b, f);
+        GifPutc(f, (int)r);
+        GifPutc(f, (int)g);
+        GifPutc(f, (int)b);
     }
 }
 
 // write the image header, LZW-compress and write out the image
-void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t width, uint32_t height, uint32_t delay, GifPalette* pPal)
+// The image is width x height pixels at (left, top) of the canvas. Its rows are stride pixels
+// apart in memory, or width pixels, if stride is 0.
+// If codetree (4096 nodes) is given, the dictionary is kept in it instead of temporary memory.
+template<class Output>
+void GifWriteLzwImage(Output* f, const uint8_t* image, uint32_t left, uint32_t top,  uint32_t width, uint32_t height, uint32_t delay, GifPalette* pPal, uint32_t stride = 0, GifLzwNode* codetree = NULL)
 {
+    GIF_TRACE_SCOPE("GifWriteLzwImage");
+    if(stride == 0) stride = width;
+
     // graphics control extension
-    fputc(0x21, f);
-    fputc(0xf9, f);
-    fputc(0x04, f);
-    fputc(0x05, f); // leave prev frame in place, this frame has transparency
-    fputc(delay & 0xff, f);
-    fputc((delay >> 8) & 0xff, f);
-    fputc(kGifTransIndex, f); // transparent color index
-    fputc(0, f);
-
-    fputc(0x2c, f); // image descriptor block
-
-    fputc(left & 0xff, f);           // corner of image in canvas space
-    fputc((left >> 8) & 0xff, f);
-    fputc(top & 0xff, f);
-    fputc((top >> 8) & 0xff, f);
-
-    fputc(width & 0xff, f);          // width and height of image
-    fputc((width >> 8) & 0xff, f);
-    fputc(height & 0xff, f);
-    fputc((height >> 8) & 0xff, f);
-
-    //fputc(0, f); // no local color table, no transparency
-    //fputc(0x80, f); // no local color table, but transparency
-
-    fputc(0x80 + pPal->bitDepth-1, f); // local color table present, 2 ^ bitDepth entries
+    GifPutc(f, 0x21);
+    GifPutc(f, 0xf9);
+    GifPutc(f, 0x04);
+    GifPutc(f, 0x05); // leave prev frame in place, this frame has transparency
+    GifPutc(f, delay & 0xff);
+    GifPutc(f, (delay >> 8) & 0xff);
+    GifPutc(f, kGifTransIndex); // transparent color index
+    GifPutc(f, 0);
+
+    GifPutc(f, 0x2c); // image descriptor block
+
+    GifPutc(f, left & 0xff);           // corner of image in canvas space
+    GifPutc(f, (left >> 8) & 0xff);
+    GifPutc(f, top & 0xff);
+    GifPutc(f, (top >> 8) & 0xff);
+
+    GifPutc(f, width & 0xff);          // width and height of image
+    GifPutc(f, (width >> 8) & 0xff);
+    GifPutc(f, height & 0xff);
+    GifPutc(f, (height >> 8) & 0xff);
+
+    //GifPutc(f, 0); // no local color table, no transparency
+    //GifPutc(f, 0x80); // no local color table, but transparency
+
+    GifPutc(f, 0x80 + pPal->bitDepth-1); // local color table present, 2 ^ bitDepth entries
     GifWritePalette(pPal, f);
 
     const int minCodeSize = pPal->bitDepth;
     const uint32_t clearCode = 1 << pPal->bitDepth;
 
-    fputc(minCodeSize, f); // min code size 8 bits
+    GifPutc(f, minCodeSize); // min code size 8 bits
 
-    GifLzwNode* codetree = (GifLzwNode*)GIF_TEMP_MALLOC(sizeof(GifLzwNode)*4096);
+    GifLzwNode* tempCodetree = codetree? NULL : (GifLzwNode*)GIF_TEMP_MALLOC(sizeof(GifLzwNode)*4096);
+    if(!codetree) codetree = tempCodetree;
 
     memset(codetree, 0, sizeof(GifLzwNode)*4096);
     int32_t curCode = -1;
@@ -661,10 +746,10 @@ void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uin
         {
     #ifdef GIF_FLIP_VERT
             // bottom-left origin image (such as an OpenGL capture)
-            uint8_t nextValue = image[((height-1-yy)*width+xx)*4+3];
+            uint8_t nextValue = image[((height-1-yy)*stride+xx)*4+3];
     #else
             // top-left origin
-            uint8_t nextValue = image[(yy*width+xx)*4+3];
+            uint8_t nextValue = image[(yy*stride+xx)*4+3];
     #endif
 
             // "loser mode" - no compression, every single code is followed immediately by a clear
@@ -719,24 +804,121 @@ void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uin
     while( stat.bitIndex ) GifWriteBit(stat, 0);
     if( stat.chunkIndex ) GifWriteChunk(f, stat);
 
-    fputc(0, f); // image block terminator
+    GifPutc(f, 0); // image block terminator
+
+    if(tempCodetree) GIF_TEMP_FREE(tempCodetree);
+}
 
-    GIF_TEMP_FREE(codetree);
+// Finds the smallest rectangle containing all pixels of a quantized frame, which are not
+// transparent, i.e. which changed since the previous frame. If no pixel changed, returns
+// the transparent top-left pixel, because a frame cannot be empty.
+void GifChangedRect( const uint8_t* image, uint32_t width, uint32_t height, uint32_t& left, uint32_t& top, uint32_t& rectWidth, uint32_t& rectHeight )
+{
+    uint32_t minX = width, maxX = 0, minY = height, maxY = 0;
+    for(uint32_t yy=0; yy<height; ++yy)
+    {
+        const uint8_t* row = image + (size_t)yy*width*4;
+        uint32_t first = 0;
+        while(first < width && row[first*4+3] == kGifTransIndex) ++first;
+        if(first == width) continue;
+        uint32_t last = width-1;
+        while(row[last*4+3] == kGifTransIndex) --last;
+
+        if(first < minX) minX = first;
+        if(last > maxX) maxX = last;
+        if(minY == height) minY = yy;
+        maxY = yy;
+    }
+
+    if(minY == height)
+    {
+        left = top = 0;
+        rectWidth = rectHeight = 1;
+        return;
+    }
+    left = minX;
+    top = minY;
+    rectWidth = maxX-minX+1;
+    rectHeight = maxY-minY+1;
+}
+
+// Writes only the part of a quantized frame, which changed since the previous frame. The
+// previous frame stays visible everywhere else.
+template<class Output>
+void GifWriteChangedImage(Output* f, const uint8_t* image, uint32_t width, uint32_t height, uint32_t delay, GifPalette* pPal, GifLzwNode* codetree = NULL)
+{
+    uint32_t left, top, rectWidth, rectHeight;
+    GifChangedRect(image, width, height, left, top, rectWidth, rectHeight);
+#ifdef GIF_FLIP_VERT
+    // the rows are written bottom-up, so the rectangle is flipped on the canvas
+    const uint32_t canvasTop = height-top-rectHeight;
+#else
+    const uint32_t canvasTop = top;
+#endif
+    GifWriteLzwImage(f, image + ((size_t)top*width + left)*4, left, canvasTop, rectWidth, rectHeight, delay, pPal, width, codetree);
 }
 
 struct GifWriter
 {
     FILE* f;
     uint8_t* oldImage;
+    uint8_t* oldSource; // the previous frame as it was passed to GifWriteFrame
+    // scratch memory reused by every frame
+    uint8_t* paletteImage;
+    int32_t* ditherPixels; // only if GifBegin was called with dither
+    GifLzwNode* codetree;
     bool firstFrame;
 };
 
+// Writes the header of a gif file, before the first frame.
+template<class Output>
+void GifWriteHeader( Output* f, uint32_t width, uint32_t height, uint32_t delay )
+{
+    GifPutBytes(f, "GIF89a", 6);
+
+    // screen descriptor
+    GifPutc(f, width & 0xff);
+    GifPutc(f, (width >> 8) & 0xff);
+    GifPutc(f, height & 0xff);
+    GifPutc(f, (height >> 8) & 0xff);
+
+    GifPutc(f, 0xf0);  // there is an unsorted global color table of 2 entries
+    GifPutc(f, 0);     // background color
+    GifPutc(f, 0);     // pixels are square (we need to specify this because it's 1989)
+
+    // now the "global" palette (really just a dummy palette)
+    // color 0: black
+    GifPutc(f, 0);
+    GifPutc(f, 0);
+    GifPutc(f, 0);
+    // color 1: also black
+    GifPutc(f, 0);
+    GifPutc(f, 0);
+    GifPutc(f, 0);
+
+    if( delay != 0 )
+    {
+        // animation header
+        GifPutc(f, 0x21); // extension
+        GifPutc(f, 0xff); // application specific
+        GifPutc(f, 11); // length 11
+        GifPutBytes(f, "NETSCAPE2.0", 11); // yes, really
+        GifPutc(f, 3); // 3 bytes of NETSCAPE2.0 data
+
+        GifPutc(f, 1); // JUST BECAUSE
+        GifPutc(f, 0); // loop infinitely (byte 0)
+        GifPutc(f, 0); // loop infinitely (byte 1)
+
+        GifPutc(f, 0); // block terminator
+    }
+}
+
 // Creates a gif file.
 // The input GIFWriter is assumed to be uninitialized.
 // The delay value is the time between frames in hundredths of a second - note that not all viewers pay much attention to this value.
 bool GifBegin( GifWriter* writer, const char* filename, uint32_t width, uint32_t height, uint32_t delay, int32_t bitDepth = 8, bool dither = false )
 {
-    (void)bitDepth; (void)dither; // Mute "Unused argument" warnings
+    (void)bitDepth; // Mute "Unused argument" warning
 #if defined(_MSC_VER) && (_MSC_VER >= 1400)
 	writer->f = 0;
     fopen_s(&writer->f, filename, "wb");
@@ -749,44 +931,12 @@ bool GifBegin( GifWriter* writer, const char* filename, uint32_t width, uint32_t
 
     // allocate
     writer->oldImage = (uint8_t*)GIF_MALLOC(width*height*4);
+    writer->oldSource = (uint8_t*)GIF_MALLOC(width*height*4);
+    writer->paletteImage = (uint8_t*)GIF_MALLOC(width*height*4);
+    writer->ditherPixels = dither? (int32_t*)GIF_MALLOC(sizeof(int32_t)*width*height*4) : NULL;
+    writer->codetree = (GifLzwNode*)GIF_MALLOC(sizeof(GifLzwNode)*4096);
 
-    fputs("GIF89a", writer->f);
-
-    // screen descriptor
-    fputc(width & 0xff, writer->f);
-    fputc((width >> 8) & 0xff, writer->f);
-    fputc(height & 0xff, writer->f);
-    fputc((height >> 8) & 0xff, writer->f);
-
-    fputc(0xf0, writer->f);  // there is an unsorted global color table of 2 entries
-    fputc(0, writer->f);     // background color
-    fputc(0, writer->f);     // pixels are square (we need to specify this because it's 1989)
-
-    // now the "global" palette (really just a dummy palette)
-    // color 0: black
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    // color 1: also black
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-
-    if( delay != 0 )
-    {
-        // animation header
-        fputc(0x21, writer->f); // extension
-        fputc(0xff, writer->f); // application specific
-        fputc(11, writer->f); // length 11
-        fputs("NETSCAPE2.0", writer->f); // yes, really
-        fputc(3, writer->f); // 3 bytes of NETSCAPE2.0 data
-
-        fputc(1, writer->f); // JUST BECAUSE
-        fputc(0, writer->f); // loop infinitely (byte 0)
-        fputc(0, writer->f); // loop infinitely (byte 1)
-
-        fputc(0, writer->f); // block terminator
-    }
+    GifWriteHeader(writer->f, width, height, delay);
 
     return true;
 }
@@ -800,17 +950,20 @@ bool GifWriteFrame( GifWriter* writer, const uint8_t* image, uint32_t width, uin
     if(!writer->f) return false;
 
     const uint8_t* oldImage = writer->firstFrame? NULL : writer->oldImage;
+    const uint8_t* oldSource = writer->firstFrame? NULL : writer->oldSource;
     writer->firstFrame = false;
 
+    // the palette is built for the pixels, which changed since the previous frame
     GifPalette pal;
-    GifMakePalette((dither? NULL : oldImage), image, width, height, bitDepth, dither, &pal);
+    GifMakePalette((dither? NULL : oldSource), image, width, height, bitDepth, dither, &pal, writer->paletteImage);
 
     if(dither)
-        GifDitherImage(oldImage, image, writer->oldImage, width, height, &pal);
+        GifDitherImage(oldImage, image, writer->oldImage, width, height, &pal, writer->ditherPixels);
     else
-        GifThresholdImage(oldImage, image, writer->oldImage, width, height, &pal);
+        GifThresholdImage(oldImage, image, writer->oldImage, width, height, &pal, NULL, oldSource);
+    memcpy(writer->oldSource, image, (size_t)width*height*4);
 
-    GifWriteLzwImage(writer->f, writer->oldImage, 0, 0, width, height, delay, &pal);
+    GifWriteChangedImage(writer->f, writer->oldImage, width, height, delay, &pal, writer->codetree);
 
     return true;
 }
@@ -825,9 +978,17 @@ bool GifEnd( GifWriter* writer )
     fputc(0x3b, writer->f); // end of file
     fclose(writer->f);
     GIF_FREE(writer->oldImage);
+    GIF_FREE(writer->oldSource);
+    GIF_FREE(writer->paletteImage);
+    if(writer->ditherPixels) GIF_FREE(writer->ditherPixels);
+    GIF_FREE(writer->codetree);
 
     writer->f = NULL;
     writer->oldImage = NULL;
+    writer->oldSource = NULL;
+    writer->paletteImage = NULL;
+    writer->ditherPixels = NULL;
+    writer->codetree = NULL;
 
     return true;
 }
@@ -0,0 +1,239 @@
+#ifndef BVH_CPP
+#define BVH_CPP
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "../include/Vector.hpp"
+#include "Shapes.cpp"
+
+// Bounding volume hierarchy over a set of primitives described only by their bounding
+// boxes. Building it orders the primitives, so that every leaf covers a contiguous range
+// [First, First + Count) of PrimitiveIndices. The caller keeps its primitives in that
+// order and is handed leaf ranges during traversal.
+class BoundingVolumeHierarchy
+{
+public:
+    struct Node
+    {
+        BoundingBox Bounds;
+        // For a leaf, index of the first primitive. For an inner node, index of the left
+        // child; the right child always follows it.
+        uint32_t First;
+        // Number of primitives in a leaf, 0 for an inner node.
+        uint32_t Count;
+    };
+
+    std::vector<Node> Nodes;
+    // PrimitiveIndices[i] is the index, which the i-th primitive in leaf order had in the
+    // bounds passed to Build.
+    std::vector<uint32_t> PrimitiveIndices;
+
+    // Builds the hierarchy using the surface area heuristic evaluated over a fixed number of
+    // bins (binned SAH), which keeps the build O(n log n).
+    void Build(const std::vector<BoundingBox> &bounds)
+    {
+        const uint32_t count = (uint32_t)bounds.size();
+        Nodes.clear();
+        PrimitiveIndices.resize(count);
+        Centroids.resize(count);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            PrimitiveIndices[i] = i;
+            Centroids[i] = bounds[i].Centroid();
+        }
+        if(count == 0)
+            return;
+        Nodes.reserve(2 * count);
+        Nodes.push_back(Node());
+        Subdivide(bounds, 0, 0, count, 0);
+    }
+
+    // Recomputes the boxes of all nodes, after the primitives moved, from bounds, which are
+    // the boxes of the primitives in the order of the leaves. The tree stays the same.
+    void Refit(const std::vector<BoundingBox> &bounds)
+    {
+        // children always come after their parent
+        for(size_t n = Nodes.size(); n-- > 0; )
+        {
+            Node &node = Nodes[n];
+            BoundingBox box;
+            if(node.Count > 0)
+                for(uint32_t i = node.First; i < node.First + node.Count; ++i)
+                    box.Extend(bounds[i]);
+            else
+            {
+                box.Extend(Nodes[node.First].Bounds);
+                box.Extend(Nodes[node.First + 1].Bounds);
+            }
+            node.Bounds = box;
+        }
+    }
+
+    // Calls visitLeaf(first, count) for every leaf, whose box is hit by the ray closer than
+    // maxDistance, visiting nearer children first. maxDistance is read again before every
+    // box test, so the visitor may shrink it while it finds closer hits. Traversal stops
+    // as soon as visitLeaf returns true.
+    template<class Visitor>
+    void Traverse(const Vec3f &origin, const Vec3f &direction, const float &maxDistance,
+        Visitor visitLeaf) const
+    {
+        if(Nodes.empty())
+            return;
+        const Vec3f inverseDirection(1.f / direction.X, 1.f / direction.Y, 1.f / direction.Z);
+        float entry, entryLeft, entryRight;
+        if(!Nodes[0].Bounds.RayIntersect(origin, inverseDirection, maxDistance, entry))
+            return;
+        uint32_t stack[MaxDepth + 1];
+        int top = 0;
+        uint32_t current = 0;
+        for(;;)
+        {
+            const Node &node = Nodes[current];
+            if(node.Count > 0)
+            {
+                if(visitLeaf(node.First, node.Count))
+                    return;
+            }
+            else
+            {
+                uint32_t left = node.First, right = node.First + 1;
+                bool hitLeft = Nodes[left].Bounds.RayIntersect(origin, inverseDirection, maxDistance, entryLeft),
+                     hitRight = Nodes[right].Bounds.RayIntersect(origin, inverseDirection, maxDistance, entryRight);
+                if(hitLeft && hitRight)
+                {
+                    if(entryRight < entryLeft)
+                        std::swap(left, right);
+                    stack[top++] = right;
+                    current = left;
+                    continue;
+                }
+                if(hitLeft) { current = left; continue; }
+                if(hitRight) { current = right; continue; }
+            }
+            if(top == 0)
+                return;
+            current = stack[--top];
+        }
+    }
+
+private:
+    static const int BinCount = 16;
+    // Leaves are always made at this depth, which bounds the traversal stack.
+    static const int MaxDepth = 60;
+    static const uint32_t MaxLeafSize = 8;
+    std::vector<Vec3f> Centroids;
+
+    void MakeLeaf(const uint32_t nodeIndex, const uint32_t first, const uint32_t count)
+    {
+        Nodes[nodeIndex].First = first;
+        Nodes[nodeIndex].Count = count;
+    }
+
+    void Subdivide(const std::vector<BoundingBox> &bounds, const uint32_t nodeIndex,
+        const uint32_t first, const uint32_t count, const int depth)
+    {
+        BoundingBox nodeBounds, centroidBounds;
+        for(uint32_t i = first; i < first + count; ++i)
+        {
+            nodeBounds.Extend(bounds[PrimitiveIndices[i]]);
+            centroidBounds.Extend(Centroids[PrimitiveIndices[i]]);
+        }
+        Nodes[nodeIndex].Bounds = nodeBounds;
+        if(count <= 2)
+        {
+            MakeLeaf(nodeIndex, first, count);
+            return;
+        }
+
+        // split along the axis, on which the centroids are spread the most
+        const Vec3f extent = centroidBounds.Max - centroidBounds.Min;
+        int axis = 0;
+        if(extent.Y > extent[axis]) axis = 1;
+        if(extent.Z > extent[axis]) axis = 2;
+        const float axisMin = centroidBounds.Min[axis], axisExtent = extent[axis];
+
+        uint32_t middle;
+        if(axisExtent <= 0.f || depth >= MaxDepth - 1)
+        {
+            // All centroids coincide or the tree is getting too deep for the SAH to be
+            // trusted, so fall back to splitting at the median.
+            if(count <= MaxLeafSize || depth >= MaxDepth - 1)
+            {
+                MakeLeaf(nodeIndex, first, count);
+                return;
+            }
+            middle = first + count / 2;
+            std::nth_element(PrimitiveIndices.begin() + first, PrimitiveIndices.begin() + middle,
+                PrimitiveIndices.begin() + first + count, [this, axis](uint32_t a, uint32_t b)
+                { return Centroids[a][axis] < Centroids[b][axis]; });
+        }
+        else
+        {
+            struct Bin { BoundingBox Bounds; uint32_t Count = 0; } bins[BinCount];
+            const float scale = BinCount / axisExtent;
+            for(uint32_t i = first; i < first + count; ++i)
+            {
+                const uint32_t p = PrimitiveIndices[i];
+                Bin &bin = bins[BinIndex(Centroids[p][axis], axisMin, scale)];
+                bin.Bounds.Extend(bounds[p]);
+                ++bin.Count;
+            }
+
+            // sweep from the right to get the cost of every right part, then from the left
+            float rightArea[BinCount - 1];
+            uint32_t rightCount[BinCount - 1];
+            BoundingBox box;
+            uint32_t sum = 0;
+            for(int i = BinCount - 1; i > 0; --i)
+            {
+                box.Extend(bins[i].Bounds);
+                sum += bins[i].Count;
+                rightArea[i - 1] = box.SurfaceArea();
+                rightCount[i - 1] = sum;
+            }
+            int bestSplit = 0;
+            float bestCost = FLT_MAX;
+            box = BoundingBox();
+            sum = 0;
+            for(int i = 0; i < BinCount - 1; ++i)
+            {
+                box.Extend(bins[i].Bounds);
+                sum += bins[i].Count;
+                const float cost = box.SurfaceArea() * sum + rightArea[i] * rightCount[i];
+                if(cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestSplit = i;
+                }
+            }
+
+            // intersecting all primitives of the node costs about as much as the SAH of a split
+            const float leafCost = nodeBounds.SurfaceArea() * count;
+            if(bestCost >= leafCost && count <= MaxLeafSize)
+            {
+                MakeLeaf(nodeIndex, first, count);
+                return;
+            }
+
+            uint32_t *const begin = PrimitiveIndices.data() + first;
+            middle = first + (uint32_t)(std::partition(begin, begin + count, [&](uint32_t p)
+                { return BinIndex(Centroids[p][axis], axisMin, scale) <= bestSplit; }) - begin);
+        }
+
+        const uint32_t left = (uint32_t)Nodes.size();
+        Nodes.push_back(Node());
+        Nodes.push_back(Node());
+        Nodes[nodeIndex].First = left;
+        Nodes[nodeIndex].Count = 0;
+        Subdivide(bounds, left, first, middle - first, depth + 1);
+        Subdivide(bounds, left + 1, middle, first + count - middle, depth + 1);
+    }
+
+    static int BinIndex(const float centroid, const float axisMin, const float scale)
+    {
+        const int i = (int)((centroid - axisMin) * scale);
+        return i < 0 ? 0 : (i >= BinCount ? BinCount - 1 : i);
+    }
+};
+#endif // BVH_CPP
@@ -0,0 +1,65 @@
+#ifndef BANDRENDERER_CPP
+#define BANDRENDERER_CPP
+
+#include <algorithm>
+#include "../include/Vector.hpp"
+#include "../include/ImageSaver.hpp"
+#include "../include/OutputSink.hpp"
+#include "Renderer.cpp"
+#include "FramePipeline.cpp"
+
+// Renders images too large to be kept in memory, e.g. posters of billions of pixels.
+// The frame is rendered in bands of BandHeight rows, which are written to the file by
+// another thread, while the next band is rendered. Only two bands, the tile queues and the
+// output's buffer are kept in memory, so the memory used depends on the band's height and
+// the number of threads, but not on the frame's height.
+class BandRenderer
+{
+public:
+    int BandHeight;
+
+    BandRenderer(const int bandHeight = 64) : BandHeight(bandHeight) {}
+
+    // Renders the frame of renderer, which may have no frame buffer, and writes it in saver's
+    // format to output, which is not closed. Returns false, if output could not be written or
+    // the format cannot store an image of the size of the frame.
+    bool Render(Renderer &renderer, ImageSaver &saver, OutputSink &output)
+    {
+        if(!saver.CanSave(renderer.Width, renderer.Height))
+            return false;
+        const int bandHeight = std::max(1, std::min(BandHeight, renderer.Height));
+        const size_t rowSize = (size_t)renderer.Width * 4;
+        saver.Begin(output, renderer.Width, renderer.Height);
+
+        // bands are consumed in the order, in which they are submitted
+        int writtenRows = 0;
+        FramePipeline pipeline(rowSize * bandHeight, 2, [&](const byte *band)
+        {
+            const int rows = std::min(bandHeight, renderer.Height - writtenRows);
+            saver.WriteRows(output, band, rows, rowSize);
+            writtenRows += rows;
+        });
+        renderer.CompileScene();
+        for(int top = 0; top < renderer.Height; top += bandHeight)
+        {
+            renderer.RenderRows(pipeline.Acquire(), top, std::min(top + bandHeight, renderer.Height));
+            pipeline.Submit();
+        }
+        pipeline.Finish();
+
+        saver.End(output);
+        return !output.Failed();
+    }
+
+    // Same as above, but writes to a file named name with saver's extension.
+    bool Render(Renderer &renderer, ImageSaver &saver, const std::string &name,
+        const OutputSinkType sinkType = OutputSinkType::Buffered)
+    {
+        std::unique_ptr<OutputSink> output = OpenOutputSink((name + saver.Extension()).c_str(), sinkType);
+        if(!output)
+            return false;
+        const bool rendered = Render(renderer, saver, *output);
+        return output->Close() && rendered;
+    }
+};
+#endif // BANDRENDERER_CPP
@@ -0,0 +1,198 @@
+#ifndef COMMANDLINE_CPP
+#define COMMANDLINE_CPP
+
+#include <cstdlib>
+#include <cerrno>
+#include <string>
+#include <ostream>
+#include "SceneGenerator.cpp"
+
+// Options of the program. Every option has a default, so the program can be started
+// without any, e.g. from Windows File Explorer.
+struct CommandLine
+{
+    // "-" is the standard output.
+    std::string Output = "output.gif";
+    // Empty for the demo scene.
+    std::string Scene;
+    // Instead of a scene file, a scene of GeneratedCount shapes (or lights) made by
+    // SceneGenerator from Seed.
+    bool Generate = false;
+    GeneratedScene GeneratedKind = GeneratedScene::Spheres;
+    int GeneratedCount = 1000, Seed = 1;
+    // "-" is the standard output. Files ending with ".csv" get CSV, other files get JSON.
+    std::string Timing;
+    // Timeline of the run in the Chrome trace event format (see Tracer); "-" is the standard
+    // output.
+    std::string Trace;
+    // Instead of the animation, only frame FirstFrame is saved as an image, whose format is
+    // given by the extension (see CreateImageSaver). It is rendered in bands of BandHeight
+    // rows straight into the file (see BandRenderer), so it may be larger than the memory.
+    std::string Still;
+    int BandHeight = 64;
+    // Cost of every pixel saved as a false-color image next to the output (see Heatmap),
+    // averaged over the saved frames and summed over the tiles of the renderer, if
+    // HeatmapTiles is true.
+    PixelCost HeatmapCost = PixelCost::None;
+    bool HeatmapTiles = false;
+    int Width = 512, Height = 512, Threads = 8;
+    // Frames [FirstFrame, FirstFrame + Frames) of the animation are saved. The scene is
+    // still advanced through the skipped frames.
+    int FirstFrame = 0, Frames = 16;
+    // Wait for return before exiting.
+    bool Wait = false;
+    bool Help = false;
+
+    // Reads the options from the program's arguments. Returns false and describes the
+    // problem in error, if an option is unknown or has a wrong value.
+    bool Parse(const int argc, const char *const argv[], std::string &error)
+    {
+        // started without arguments, the program keeps its window open until return is pressed
+        Wait = argc <= 1;
+        int positional = 0;
+        for(int i = 1; i < argc; ++i)
+        {
+            const std::string option = argv[i];
+            const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+            bool valid = true;
+            if(option == "--help")
+                Help = true;
+            else if(option == "--wait")
+                Wait = true;
+            else if(option == "--output" || option == "--scene" || option == "--timing" || option == "--trace" ||
+                option == "--still")
+            {
+                valid = value != nullptr;
+                if(valid)
+                    (option == "--output" ? Output : option == "--scene" ? Scene :
+                        option == "--timing" ? Timing : option == "--trace" ? Trace : Still) = value;
+                ++i;
+            }
+            else if(option == "--heatmap-tiles")
+                HeatmapTiles = true;
+            else if(option == "--heatmap")
+            {
+                const std::string cost = value ? value : "";
+                valid = cost == "time" || cost == "tests";
+                HeatmapCost = cost == "tests" ? PixelCost::IntersectionTests : PixelCost::Nanoseconds;
+                ++i;
+            }
+            else if(option == "--generate")
+            {
+                valid = value != nullptr && SceneGenerator::ParseKind(value, GeneratedKind);
+                Generate = true;
+                ++i;
+            }
+            else if(option == "--width" || option == "--height" || option == "--threads" ||
+                option == "--frames" || option == "--first-frame" || option == "--count" || option == "--seed" ||
+                option == "--band-height")
+            {
+                int &target = option == "--width" ? Width : option == "--height" ? Height :
+                    option == "--threads" ? Threads : option == "--frames" ? Frames :
+                    option == "--first-frame" ? FirstFrame : option == "--count" ? GeneratedCount :
+                    option == "--seed" ? Seed : BandHeight;
+                const int minimum = option == "--first-frame" || option == "--seed" ? 0 : 1,
+                    maximum = option == "--threads" ? 255 : option == "--count" || option == "--seed" ?
+                        2000000000 : 1 << 20;
+                valid = ParseInteger(value, minimum, maximum, target);
+                ++i;
+            }
+            else if(option.size() > 1 && option[0] == '-' && option[1] == '-')
+            {
+                error = "unknown option " + option;
+                return false;
+            }
+            // the output and the scene can be given without the option's name
+            else if(positional == 0)
+            {
+                Output = option;
+                ++positional;
+            }
+            else if(positional == 1)
+            {
+                Scene = option;
+                ++positional;
+            }
+            else
+            {
+                error = "unexpected argument " + option;
+                return false;
+            }
+            if(!valid)
+            {
+                error = "option " + option + " needs a valid value";
+                return false;
+            }
+        }
+        if(Generate && !Scene.empty())
+        {
+            error = "a scene cannot be both loaded and generated";
+            return false;
+        }
+        if(HeatmapCost == PixelCost::IntersectionTests && !RayCounters::Enabled())
+        {
+            error = "intersection tests are counted only if the program is built with RENDERER_COUNTERS=1";
+            return false;
+        }
+        if(HeatmapTiles && HeatmapCost == PixelCost::None)
+            HeatmapCost = PixelCost::Nanoseconds;
+        if(!Still.empty() && HeatmapCost != PixelCost::None)
+        {
+            error = "a heatmap cannot be recorded for a still image";
+            return false;
+        }
+        // a still image replaces the animation
+        const std::string &image = Still.empty() ? Output : Still;
+        if((image == "-") + (Timing == "-") + (Trace == "-") > 1)
+        {
+            error = "only one of the image, the timing and the trace can be written to the standard output";
+            return false;
+        }
+        return true;
+    }
+
+    static void PrintUsage(std::ostream &output)
+    {
+        output <<
+            "usage: 3DRenderer [OUTPUT [SCENE]] [options]\n"
+            "  --output FILE       animation file: .gif, .y4m, .rgba or - for Y4M on the standard output\n"
+            "                      (output.gif)\n"
+            "  --scene FILE        text or binary scene file (the demo scene)\n"
+            "  --generate KIND     generated scene: spheres, rectangles, ellipses or lights\n"
+            "  --count N           number of generated shapes, or lights for lights (1000)\n"
+            "  --seed N            seed of the generated scene (1)\n"
+            "  --width N           width of the frames in pixels (512)\n"
+            "  --height N          height of the frames in pixels (512)\n"
+            "  --threads N         number of rendering threads, 1 to 255 (8)\n"
+            "  --frames N          number of saved frames (16)\n"
+            "  --first-frame N     number of the first saved frame (0)\n"
+            "  --still FILE        save only the first frame as an image rendered in bands straight\n"
+            "                      into the file: .bmp, .ppm, .rgb, .png or .qoi\n"
+            "  --band-height N     rows rendered at once for --still (64)\n"
+            "  --timing FILE       write the timing of the run and of every frame as CSV, if FILE\n"
+            "                      ends with .csv, otherwise as JSON; - for the standard output\n"
+            "  --trace FILE        write the timeline of the rendering and encoding threads in the\n"
+            "                      Chrome trace event format (chrome://tracing, ui.perfetto.dev)\n"
+            "  --heatmap COST      save the cost of every pixel as OUTPUT.heatmap.png, where COST is\n"
+            "                      time or tests (intersection tests, if built with RENDERER_COUNTERS=1)\n"
+            "  --heatmap-tiles     show the cost of every tile instead of every pixel (time by default)\n"
+            "  --wait              wait for return before exiting, which is the default only\n"
+            "                      without any arguments\n"
+            "  --help              print this text\n";
+    }
+
+private:
+    static bool ParseInteger(const char *text, const int minimum, const int maximum, int &value)
+    {
+        if(!text)
+            return false;
+        char *end;
+        errno = 0;
+        const long parsed = strtol(text, &end, 10);
+        if(end == text || *end != '\0' || errno != 0 || parsed < minimum || parsed > maximum)
+            return false;
+        value = (int)parsed;
+        return true;
+    }
+};
+#endif // COMMANDLINE_CPP
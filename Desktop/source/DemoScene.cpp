@@ -0,0 +1,80 @@
+#ifndef DEMOSCENE_CPP
+#define DEMOSCENE_CPP
+
+#include "../include/Vector.hpp"
+#include "Shapes.cpp"
+#include "Renderer.cpp"
+
+// The animation made by the program: a mirror sphere bouncing in front of three walls and
+// a rectangle, followed by the camera.
+class DemoScene
+{
+public:
+    // Adds the shapes and the lights to the renderer, which deletes them.
+    DemoScene(Renderer &renderer) : Target(renderer), Velocity(-0.25f)
+    {
+        // predefined materials
+        Material      ivory(1.0, Vec4f(0.6,  0.3, 0.1, 0.0), Vec3f(0.4, 0.4, 0.3),   50.);
+        Material      glass(1.5, Vec4f(0.0,  0.5, 0.1, 0.8), Vec3f(0.6, 0.7, 0.8),  125.);
+        Material red_rubber(1.0, Vec4f(0.9,  0.1, 0.0, 0.0), Vec3f(0.3, 0.1, 0.1),   10.);
+        Material     mirror(1.0, Vec4f(0.0, 10.0, 0.8, 0.0), Vec3f(1.0, 1.0, 1.0), 1425.);
+
+        Material blue_rubber(red_rubber.RefractiveIndex, red_rubber.Albedo,
+            Vec3f(0.1, 0.1, 0.3), red_rubber.SpecularExponent);
+
+        // walls
+        renderer.Shapes.push_back(new Plane(Vec3f(-6,0,-20), Vec3f(1,0,0).Normalize(),
+            ivory));
+        renderer.Shapes.push_back(new Plane(Vec3f(5,0,-15), Vec3f(0,0,1).Normalize(),
+            red_rubber));
+        renderer.Shapes.push_back(new Plane(Vec3f(0,-4,0), Vec3f(0,1,0).Normalize(),
+            blue_rubber));
+
+        // shapes
+        // renderer.Shapes.push_back(new Circle(Vec3f(-3,0,-10), 2, Vec3f(0,1,1).Normalize(),
+        //    ivory));
+        Rectangle *rectangle = new Rectangle(Vec3f(3,2,-6), 2, 2, Vec3f(0,0,1).Normalize(),
+            ivory);
+        rectangle->SetDirection(Vec3f(1,1,0).Normalize());
+        renderer.Shapes.push_back(rectangle);
+        Ball = new Sphere(Vec3f(3,5,-10), 2,
+            mirror);
+        renderer.Shapes.push_back(Ball);
+        // renderer.Shapes.push_back(new Ellipse(Vec3f(6,0,-10), Vec3f(6,0,-10), 1, Vec3f(0,0,1).Normalize(),
+        //    ivory));
+
+        renderer.Lights.push_back(new Light(Vec3f(-5, 10,  -1), 1.5));
+        renderer.Lights.push_back(new Light(Vec3f( 5, 10, -1), 1.8));
+        renderer.Lights.push_back(new Light(Vec3f( 5, 20,  -1), 1.7));
+
+        // Negative angle rotates clockwise.
+        // renderer.Eye.RotateY(-M_PI / 2);
+
+        renderer.Eye.Position.Z = 5;
+        //renderer.Eye.SetDirection(Vec3f(0,0,1));
+        //renderer.Eye.RotateY(-M_PI / 12.f);
+    }
+
+    // Points the camera at the sphere. Called before rendering every frame.
+    void PrepareFrame()
+    {
+        Vec3f dir = Ball->Center - Target.Eye.Position;
+        Target.Eye.SetDirection(dir.Normalize());
+    }
+
+    // Moves the sphere to its position in the next frame.
+    void Advance()
+    {
+        if(Ball->Center.Y - Ball->Radius <= 0)
+            Velocity = -Velocity;
+        else if(Ball->Center.Y + Ball->Radius >= 10)
+            Velocity = -Velocity;
+        Ball->Center.Y += Velocity;
+    }
+
+private:
+    Renderer &Target;
+    Sphere *Ball;
+    float Velocity;
+};
+#endif // DEMOSCENE_CPP
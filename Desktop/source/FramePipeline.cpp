@@ -0,0 +1,115 @@
+#ifndef FRAMEPIPELINE_CPP
+#define FRAMEPIPELINE_CPP
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "../include/Vector.hpp"
+#include "Tracer.cpp"
+
+// Overlaps rendering of a frame with consuming (e.g. encoding) the frames rendered before it.
+// The producer renders into one of a fixed ring of frame buffers and submits it. A consumer
+// thread owned by the pipeline passes the submitted buffers to the consumer function in
+// submission order. When every buffer of the ring waits to be consumed, the producer blocks
+// in Acquire, so it never gets more than the ring's size ahead of the consumer.
+class FramePipeline
+{
+public:
+    typedef std::function<void(const byte *frame)> Consumer;
+
+    // ringSize is the number of frame buffers, each of frameSize bytes. With 2 buffers, one
+    // frame is rendered while the previous one is consumed.
+    FramePipeline(const size_t frameSize, const byte ringSize, const Consumer &consume)
+        : Consume(consume), Submitted(0), Consumed(0), Acquired(false), Stopping(false)
+    {
+        const byte totalBuffers = ringSize > 0 ? ringSize : 1;
+        for(byte i = 0; i < totalBuffers; ++i)
+            Buffers.emplace_back(new byte[frameSize]);
+        ConsumerThread = std::thread(&FramePipeline::ConsumerLoop, this);
+    }
+    ~FramePipeline()
+    {
+        Finish();
+    }
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Returns the buffer, into which the next frame should be rendered. Blocks while all
+    // buffers hold frames, which have not been consumed yet.
+    byte* Acquire()
+    {
+        TraceScope trace("AcquireFrameBuffer");
+        std::unique_lock<std::mutex> lock(Mutex);
+        FreeCondition.wait(lock, [this] { return Submitted - Consumed < Buffers.size(); });
+        Acquired = true;
+        return Buffers[Submitted % Buffers.size()].get();
+    }
+
+    // Queues the buffer returned by the last Acquire call for the consumer.
+    void Submit()
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            if(!Acquired)
+                return;
+            Acquired = false;
+            ++Submitted;
+        }
+        SubmitCondition.notify_one();
+    }
+
+    // Waits until all submitted frames are consumed and stops the consumer thread. No frames
+    // can be submitted afterwards.
+    void Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Stopping = true;
+        }
+        SubmitCondition.notify_one();
+        if(ConsumerThread.joinable())
+            ConsumerThread.join();
+    }
+
+private:
+    Consumer Consume;
+    std::vector<std::unique_ptr<byte[]>> Buffers;
+    std::thread ConsumerThread;
+    std::mutex Mutex;
+    // Signalled when a frame is submitted or the pipeline is being finished.
+    std::condition_variable SubmitCondition;
+    // Signalled when a frame is consumed, so its buffer can be reused.
+    std::condition_variable FreeCondition;
+    // Numbers of frames submitted and consumed so far. Frame i is kept in
+    // Buffers[i % Buffers.size()].
+    size_t Submitted, Consumed;
+    bool Acquired, Stopping;
+
+    void ConsumerLoop()
+    {
+        for(;;)
+        {
+            const byte *frame;
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                SubmitCondition.wait(lock, [this] { return Stopping || Submitted != Consumed; });
+                if(Submitted == Consumed)
+                    return; // stopping and everything is consumed
+                frame = Buffers[Consumed % Buffers.size()].get();
+            }
+
+            Tracer::NameThread("frame consumer");
+            Consume(frame);
+
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                ++Consumed;
+            }
+            FreeCondition.notify_one();
+        }
+    }
+};
+#endif // FRAMEPIPELINE_CPP
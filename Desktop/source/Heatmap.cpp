@@ -0,0 +1,101 @@
+#ifndef HEATMAP_CPP
+#define HEATMAP_CPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "../include/Vector.hpp"
+#include "../include/ImageSaver.hpp"
+
+// False-color image of the costs of pixels recorded by the renderer (see Renderer::RecordCost),
+// which shows the parts of the frame, that take most time or intersection tests. The costs of
+// all added frames are averaged. Colors go from black (no cost) through blue, cyan, green and
+// yellow to red, which is the cost of the 99th percentile of pixels or more, so a few very
+// expensive pixels do not make all other pixels dark.
+class Heatmap
+{
+public:
+    // If not 0, every pixel shows the total cost of its TileWidth x TileHeight tile, like the
+    // tiles of the renderer, instead of its own.
+    int TileWidth, TileHeight;
+
+    Heatmap() : TileWidth(0), TileHeight(0), Width(0), Height(0), Frames(0) {}
+
+    // Adds the costs of a width x height frame.
+    void Add(const std::vector<float> &costs, const int width, const int height)
+    {
+        if(width != Width || height != Height)
+        {
+            Width = width;
+            Height = height;
+            Costs.assign((size_t)width * height, 0.f);
+            Frames = 0;
+        }
+        ++Frames;
+        const size_t count = std::min(Costs.size(), costs.size());
+        for(size_t i = 0; i < count; ++i)
+            Costs[i] += costs[i];
+    }
+
+    // Number of frames added since the size of the frames last changed.
+    uint32_t FrameCount() const { return Frames; }
+
+    // Saves the image in saver's format. The cost shown as red, per pixel (or tile) and frame
+    // on average over the added frames, is stored in maximumCost. Returns false, if the file
+    // could not be written.
+    bool Save(const std::string &name, ImageSaver &saver, float &maximumCost) const
+    {
+        const std::vector<float> costs = TileWidth > 0 && TileHeight > 0 ? TileCosts() : Costs;
+        std::vector<byte> pixels(costs.size() * 4);
+        maximumCost = Colorize(costs, pixels.data()) / std::max(Frames, 1u);
+        return saver.Save(name, Width, Height, pixels.data());
+    }
+
+    // Converts the costs to RGBA colors. Returns the cost shown as red.
+    static float Colorize(const std::vector<float> &costs, byte *rgba)
+    {
+        std::vector<float> sorted(costs);
+        const size_t percentile = sorted.size() * 99 / 100;
+        float maximum = 0;
+        if(!sorted.empty())
+        {
+            std::nth_element(sorted.begin(), sorted.begin() + percentile, sorted.end());
+            maximum = sorted[percentile];
+        }
+        if(maximum <= 0)
+            maximum = 1;
+        // colors at equal steps from 0 to maximum
+        static const float stops[6][3] = { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } };
+        for(size_t i = 0; i < costs.size(); ++i, rgba += 4)
+        {
+            const float t = std::min(std::max(costs[i] / maximum, 0.f), 1.f) * 5.f;
+            const int stop = std::min((int)t, 4);
+            const float f = t - stop;
+            for(int c = 0; c < 3; ++c)
+                rgba[c] = (byte)(255.f * (stops[stop][c] + (stops[stop + 1][c] - stops[stop][c]) * f) + 0.5f);
+            rgba[3] = 255;
+        }
+        return maximum;
+    }
+
+private:
+    int Width, Height;
+    uint32_t Frames;
+    // sums of the costs of all added frames
+    std::vector<float> Costs;
+
+    std::vector<float> TileCosts() const
+    {
+        const int columns = (Width + TileWidth - 1) / TileWidth;
+        std::vector<float> tiles((size_t)columns * ((Height + TileHeight - 1) / TileHeight), 0.f);
+        for(int y = 0; y < Height; ++y)
+            for(int x = 0; x < Width; ++x)
+                tiles[(size_t)(y / TileHeight) * columns + x / TileWidth] += Costs[(size_t)y * Width + x];
+        std::vector<float> costs(Costs.size());
+        for(int y = 0; y < Height; ++y)
+            for(int x = 0; x < Width; ++x)
+                costs[(size_t)y * Width + x] = tiles[(size_t)(y / TileHeight) * columns + x / TileWidth];
+        return costs;
+    }
+};
+#endif // HEATMAP_CPP
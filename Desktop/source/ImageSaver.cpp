@@ -1,81 +1,402 @@
 #include "../include/ImageSaver.hpp"
+#include <cstdio>
+#include <cstdint>
 
-void PPMSaver::Save(std::string name, unsigned int width, unsigned int height, Vec3f* pixels)
+bool ImageSaver::Save(const std::string &name, unsigned int width, unsigned int height, const byte *pixels, size_t stride)
 {
-    std::ofstream ofs; // save the framebuffer to file
-    ofs.open(name + ".ppm", std::ios::binary);
-    ofs << "P6\n" << width << " " << height << "\n255\n";
-    unsigned int i, j;
-    float max;
-    for (i = 0; i < height * width; ++i)
+    if(!CanSave(width, height))
+        return false;
+    std::unique_ptr<OutputSink> output = OpenOutputSink((name + Extension()).c_str());
+    if(!output)
+        return false;
+    Write(*output, width, height, pixels, stride);
+    return output->Close();
+}
+
+bool ImageSaver::Save(const std::string &name, unsigned int width, unsigned int height, const Vec3f *pixels)
+{
+    std::vector<byte> image((size_t)width * height * 4);
+    for(size_t i = 0; i < (size_t)width * height; ++i)
     {
-        Vec3f &c = pixels[i];
-        max = std::max(c[0], std::max(c[1], c[2]));
+        Vec3f c = pixels[i];
+        const float max = std::max(c[0], std::max(c[1], c[2]));
         if (max > 1) c = c * (1. / max);
-        for (j = 0; j < 3; ++j)
-        {
-            ofs << (char)(255 * std::max(0.f, std::min(1.f, c[j])));
-        }
+        for(int j = 0; j < 3; ++j)
+            image[i * 4 + j] = (byte)(255 * std::max(0.f, std::min(1.f, c[j])));
+        image[i * 4 + 3] = 255;
+    }
+    return Save(name, width, height, image.data());
+}
+
+std::unique_ptr<ImageSaver> CreateImageSaver(const std::string &name)
+{
+    const size_t dot = name.find_last_of('.');
+    const std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+    if(extension == ".bmp") return std::unique_ptr<ImageSaver>(new BMPSaver);
+    if(extension == ".ppm") return std::unique_ptr<ImageSaver>(new PPMSaver);
+    if(extension == ".rgb") return std::unique_ptr<ImageSaver>(new RawSaver);
+    if(extension == ".png") return std::unique_ptr<ImageSaver>(new PNGSaver);
+    if(extension == ".qoi") return std::unique_ptr<ImageSaver>(new QOISaver);
+    return nullptr;
+}
+
+// Copies the RGB bytes of width RGBA pixels to out.
+static void CopyRGB(const byte *pixels, byte *out, const unsigned int width)
+{
+    for(unsigned int x = 0; x < width; ++x, pixels += 4, out += 3)
+    {
+        out[0] = pixels[0];
+        out[1] = pixels[1];
+        out[2] = pixels[2];
     }
-    ofs.close();
 }
 
-void BMPSaver::WriteBytes(unsigned int value, const unsigned char byteCount)
+void ImageSaver::Write(OutputSink &output, unsigned int width, unsigned int height, const byte* pixels, size_t stride)
+{
+    Begin(output, width, height);
+    WriteRows(output, pixels, height, stride);
+    End(output);
+}
+
+void PPMSaver::Begin(OutputSink &output, unsigned int width, unsigned int height)
+{
+    Width = width;
+    Height = height;
+    char header[64];
+    const int headerLength = std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+    output.Write(header, (size_t)headerLength);
+    Row.resize((size_t)width * 3);
+}
+void PPMSaver::WriteRows(OutputSink &output, const byte* pixels, unsigned int rows, size_t stride)
+{
+    if(stride == 0) stride = (size_t)Width * 4;
+    for(unsigned int y = 0; y < rows; ++y)
+    {
+        CopyRGB(pixels + y * stride, Row.data(), Width);
+        output.Write(Row.data(), Row.size());
+    }
+}
+
+void RawSaver::Begin(OutputSink &, unsigned int width, unsigned int height)
+{
+    Width = width;
+    Height = height;
+    Row.resize((size_t)width * 3);
+}
+void RawSaver::WriteRows(OutputSink &output, const byte* pixels, unsigned int rows, size_t stride)
+{
+    if(stride == 0) stride = (size_t)Width * 4;
+    for(unsigned int y = 0; y < rows; ++y)
+    {
+        CopyRGB(pixels + y * stride, Row.data(), Width);
+        output.Write(Row.data(), Row.size());
+    }
+}
+
+void BMPSaver::WriteBytes(OutputSink &output, unsigned int value, const unsigned char byteCount)
 {
     for(unsigned int i = 0; i < byteCount; ++i)
     {
-        OutputStream.put(value % 256);
+        output.Put(value % 256);
         value /= 256;
     }
 }
-void BMPSaver::Save(std::string name, unsigned int width, unsigned int height, Vec3f* pixels)
+uint64_t BMPSaver::PixelBytes(unsigned int width, unsigned int height)
+{
+    return ((uint64_t)width * 3 + 3) / 4 * 4 * height;
+}
+bool BMPSaver::CanSave(unsigned int width, unsigned int height) const
+{
+    return 54 + PixelBytes(width, height) <= UINT32_MAX && height <= INT32_MAX;
+}
+void BMPSaver::WriteHeader(OutputSink &output, unsigned int width, unsigned int height, const bool topDown)
 {
+    Width = width;
+    Height = height;
     const unsigned int extraBytes = ( 4 - ((width * 3) % 4) ) % 4;
-    OutputStream = std::ofstream(name + ".bmp", std::ios::binary);
+    // the sizes are wrong for images, which CanSave refuses
+    const unsigned int pixelBytes = (unsigned int)PixelBytes(width, height);
 
     //BMP header
-    WriteBytes('B', 1);
-    WriteBytes('M', 1);
-    WriteBytes(54 + (width * 3 + extraBytes) * height, 4);
-    WriteBytes(0, 2);
-    WriteBytes(0, 2);
-    WriteBytes(54, 4);
+    WriteBytes(output, 'B', 1);
+    WriteBytes(output, 'M', 1);
+    WriteBytes(output, 54 + pixelBytes, 4);
+    WriteBytes(output, 0, 2);
+    WriteBytes(output, 0, 2);
+    WriteBytes(output, 54, 4);
 
     //DIB header
-    WriteBytes(40, 4);
-    WriteBytes(width, 4);
-    WriteBytes(height, 4);
-    WriteBytes(1, 2);
-    WriteBytes(24, 2);
-    WriteBytes(0, 4);
-
-    WriteBytes((width * 3 + extraBytes) * height, 4);
+    WriteBytes(output, 40, 4);
+    WriteBytes(output, width, 4);
+    WriteBytes(output, topDown ? 0u - height : height, 4);
+    WriteBytes(output, 1, 2);
+    WriteBytes(output, 24, 2);
+    WriteBytes(output, 0, 4);
+
+    WriteBytes(output, pixelBytes, 4);
     //WriteValue(output, 0, 4);//też zadziała przy braku kompresji (czyli tak, jak jest standardowo)
 
-    WriteBytes(0, 4);
-    WriteBytes(0, 4);
-    WriteBytes(0, 4);
-    WriteBytes(0, 4);
+    WriteBytes(output, 0, 4);
+    WriteBytes(output, 0, 4);
+    WriteBytes(output, 0, 4);
+    WriteBytes(output, 0, 4);
 
-    //pixel array (bitmap data)
+    Row.assign((size_t)width * 3 + extraBytes, 0);
+}
+void BMPSaver::ConvertRow(const byte *p)
+{
+    byte *r = Row.data();
+    for(unsigned int x = 0; x < Width; ++x, p += 4, r += 3)
+    {
+        r[0] = p[2];
+        r[1] = p[1];
+        r[2] = p[0];
+    }
+}
+void BMPSaver::Begin(OutputSink &output, unsigned int width, unsigned int height)
+{
+    WriteHeader(output, width, height, true);
+}
+void BMPSaver::WriteRows(OutputSink &output, const byte* pixels, unsigned int rows, size_t stride)
+{
+    if(stride == 0) stride = (size_t)Width * 4;
+    for(unsigned int y = 0; y < rows; ++y)
+    {
+        ConvertRow(pixels + y * stride);
+        output.Write(Row.data(), Row.size());
+    }
+}
+void BMPSaver::Write(OutputSink &output, unsigned int width, unsigned int height, const byte* pixels, size_t stride)
+{
+    if(stride == 0) stride = (size_t)width * 4;
+    WriteHeader(output, width, height, false);
+    //pixel array (bitmap data), from the bottom row
+    for(unsigned int y = height; y-- > 0; )
+    {
+        ConvertRow(pixels + y * stride);
+        output.Write(Row.data(), Row.size());
+    }
+}
+
+static void WriteBigEndian(OutputSink &output, const uint32_t value)
+{
+    output.Put((byte)(value >> 24));
+    output.Put((byte)(value >> 16));
+    output.Put((byte)(value >> 8));
+    output.Put((byte)value);
+}
+
+void QOISaver::Begin(OutputSink &output, unsigned int width, unsigned int height)
+{
+    Width = width;
+    Height = height;
+    output.Write("qoif", 4);
+    WriteBigEndian(output, width);
+    WriteBigEndian(output, height);
+    output.Put(3); // RGB
+    output.Put(0); // sRGB with linear alpha
+
+    memset(Index, 0, sizeof(Index));
+    memset(Previous, 0, sizeof(Previous));
+    Run = 0;
+}
+void QOISaver::WriteRows(OutputSink &output, const byte* pixels, unsigned int rows, size_t stride)
+{
+    if(stride == 0) stride = (size_t)Width * 4;
+    byte (*const index)[4] = Index;
+    byte *const previous = Previous;
+    int run = Run;
+    for(unsigned int y = 0; y < rows; ++y)
+    {
+        const byte *p = pixels + y * stride;
+        for(unsigned int x = 0; x < Width; ++x, p += 4)
+        {
+            if(p[0] == previous[0] && p[1] == previous[1] && p[2] == previous[2])
+            {
+                if(++run == 62)
+                {
+                    output.Put(0xc0 | (run - 1)); // QOI_OP_RUN
+                    run = 0;
+                }
+                continue;
+            }
+            if(run > 0)
+            {
+                output.Put(0xc0 | (run - 1));
+                run = 0;
+            }
+
+            const int hash = (p[0] * 3 + p[1] * 5 + p[2] * 7 + 255 * 11) % 64;
+            if(index[hash][0] == p[0] && index[hash][1] == p[1] && index[hash][2] == p[2] && index[hash][3] == 255)
+                output.Put(hash); // QOI_OP_INDEX
+            else
+            {
+                index[hash][0] = p[0];
+                index[hash][1] = p[1];
+                index[hash][2] = p[2];
+                index[hash][3] = 255;
+                const int dr = (int8_t)(p[0] - previous[0]),
+                    dg = (int8_t)(p[1] - previous[1]),
+                    db = (int8_t)(p[2] - previous[2]);
+                const int drg = dr - dg, dbg = db - dg;
+                if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    output.Put(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)); // QOI_OP_DIFF
+                else if(dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+                {
+                    output.Put(0x80 | (dg + 32)); // QOI_OP_LUMA
+                    output.Put((drg + 8) << 4 | (dbg + 8));
+                }
+                else
+                {
+                    output.Put(0xfe); // QOI_OP_RGB
+                    output.Write(p, 3);
+                }
+            }
+            previous[0] = p[0];
+            previous[1] = p[1];
+            previous[2] = p[2];
+        }
+    }
+    Run = run;
+}
+void QOISaver::End(OutputSink &output)
+{
+    if(Run > 0)
+        output.Put(0xc0 | (Run - 1));
+    Run = 0;
+
+    static const byte end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    output.Write(end, sizeof(end));
+}
+
+// CRC-32 used by PNG chunks.
+static uint32_t UpdateCrc(uint32_t crc, const byte *data, size_t size)
+{
+    struct Table
+    {
+        uint32_t Entries[256];
+        Table()
+        {
+            for(uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for(int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                Entries[n] = c;
+            }
+        }
+    };
+    static const Table table;
+    for(size_t i = 0; i < size; ++i)
+        crc = table.Entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
 
-    unsigned int x, y, i = width * (height - 1);
-    int j;
-    float max;
-    for(y = 0; y < height; ++y)
+void PNGSaver::WriteChunk(OutputSink &output, const char *type, const byte *data, size_t size)
+{
+    WriteBigEndian(output, (uint32_t)size);
+    output.Write(type, 4);
+    if(size > 0)
+        output.Write(data, size);
+    uint32_t crc = UpdateCrc(0xffffffffu, (const byte*)type, 4);
+    crc = UpdateCrc(crc, data, size);
+    WriteBigEndian(output, crc ^ 0xffffffffu);
+}
+
+// The Chunk holds [zlib header (first chunk only)][block header][up to 65535 bytes of the
+// block][Adler-32 (last chunk only)].
+static const size_t PngBlockOffset = 2 + 5, PngMaxBlock = 65535;
+
+void PNGSaver::Deflate(OutputSink &output, const byte *data, size_t size)
+{
+    // Adler-32, taking the modulo only as often as the sums could overflow
+    uint32_t a = AdlerA, b = AdlerB;
+    for(size_t i = 0; i < size; )
     {
-        for(x = 0; x < width; ++x)
+        const size_t end = std::min(size, i + 5552);
+        for( ; i < end; ++i)
         {
-            Vec3f &c = pixels[i];
-            max = std::max(c[0], std::max(c[1], c[2]));
-            if (max > 1) c = c * (1. / max);
-            for (j = 2; j >= 0; --j)
-                OutputStream.put((char)(255 * std::max(0.f, std::min(1.f, c[j]))));
-            ++i;
+            a += data[i];
+            b += a;
         }
-        for(j = 0; j < extraBytes; ++j)
-            OutputStream.put(0);
-        i = i - 2 * width;
+        a %= 65521;
+        b %= 65521;
+    }
+    AdlerA = a;
+    AdlerB = b;
+
+    while(size > 0)
+    {
+        const size_t part = std::min(size, PngMaxBlock - ChunkUsed);
+        memcpy(Chunk.data() + PngBlockOffset + ChunkUsed, data, part);
+        ChunkUsed += part;
+        data += part;
+        size -= part;
+        if(ChunkUsed == PngMaxBlock)
+            WriteBlock(output, false);
+    }
+}
+
+void PNGSaver::WriteBlock(OutputSink &output, const bool last)
+{
+    byte *const chunk = Chunk.data();
+    chunk[0] = 0x78; // deflate with a 32 KiB window
+    chunk[1] = 0x01; // no dictionary, fastest compression
+    chunk[2] = last ? 1 : 0; // stored block
+    chunk[3] = (byte)ChunkUsed;
+    chunk[4] = (byte)(ChunkUsed >> 8);
+    chunk[5] = (byte)~ChunkUsed;
+    chunk[6] = (byte)(~ChunkUsed >> 8);
+    size_t end = PngBlockOffset + ChunkUsed;
+    if(last)
+    {
+        const uint32_t adler = AdlerB << 16 | AdlerA;
+        chunk[end++] = (byte)(adler >> 24);
+        chunk[end++] = (byte)(adler >> 16);
+        chunk[end++] = (byte)(adler >> 8);
+        chunk[end++] = (byte)adler;
+    }
+    const size_t begin = FirstChunk ? 0 : 2;
+    WriteChunk(output, "IDAT", chunk + begin, end - begin);
+    FirstChunk = false;
+    ChunkUsed = 0;
+}
+
+void PNGSaver::Begin(OutputSink &output, unsigned int width, unsigned int height)
+{
+    Width = width;
+    Height = height;
+    static const byte signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    output.Write(signature, sizeof(signature));
+
+    const byte header[13] = {
+        (byte)(width >> 24), (byte)(width >> 16), (byte)(width >> 8), (byte)width,
+        (byte)(height >> 24), (byte)(height >> 16), (byte)(height >> 8), (byte)height,
+        8, // bits per channel
+        2, // RGB
+        0, 0, 0 }; // deflate, adaptive filtering, no interlace
+    WriteChunk(output, "IHDR", header, sizeof(header));
+
+    Chunk.resize(PngBlockOffset + PngMaxBlock + 4);
+    ChunkUsed = 0;
+    FirstChunk = true;
+    AdlerA = 1;
+    AdlerB = 0;
+    // every row starts with its filter type, which is none
+    Row.resize((size_t)width * 3 + 1);
+    Row[0] = 0;
+}
+void PNGSaver::WriteRows(OutputSink &output, const byte* pixels, unsigned int rows, size_t stride)
+{
+    if(stride == 0) stride = (size_t)Width * 4;
+    for(unsigned int y = 0; y < rows; ++y)
+    {
+        CopyRGB(pixels + y * stride, Row.data() + 1, Width);
+        Deflate(output, Row.data(), Row.size());
     }
-    OutputStream.close();
+}
+void PNGSaver::End(OutputSink &output)
+{
+    WriteBlock(output, true);
+    WriteChunk(output, "IEND", NULL, 0);
 }
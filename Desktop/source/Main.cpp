@@ -2,7 +2,15 @@
 #include "../include/Vector.hpp"
 #include "Shapes.cpp"
 #include "Renderer.cpp"
-#include "../include/gif.h"
+#include "FramePipeline.cpp"
+#include "BandRenderer.cpp"
+#include "DemoScene.cpp"
+#include "SceneFile.cpp"
+#include "VideoWriter.cpp"
+#include "CommandLine.cpp"
+#include "TimingReport.cpp"
+#include "Heatmap.cpp"
+#include "../include/GifParallel.hpp"
 
 inline Vec3b randomColor()
 {
@@ -10,94 +18,216 @@ inline Vec3b randomColor()
 }
 //#define randomColor() {Vec3b( rand() & 255, rand() & 255, rand() & 255 )}
 
-int main()
+// Returns true, if text ends with suffix.
+inline bool EndsWith(const std::string &text, const std::string &suffix)
 {
-    Renderer renderer(512, 512, 8);
-    GifWriter writer;
-    const uint32_t delay = 20;
-	GifBegin(&writer, "output.gif", renderer.Width, renderer.Height, delay);
-
-    // predefined materials
-    Material      ivory(1.0, Vec4f(0.6,  0.3, 0.1, 0.0), Vec3f(0.4, 0.4, 0.3),   50.);
-    Material      glass(1.5, Vec4f(0.0,  0.5, 0.1, 0.8), Vec3f(0.6, 0.7, 0.8),  125.);
-    Material red_rubber(1.0, Vec4f(0.9,  0.1, 0.0, 0.0), Vec3f(0.3, 0.1, 0.1),   10.);
-    Material     mirror(1.0, Vec4f(0.0, 10.0, 0.8, 0.0), Vec3f(1.0, 1.0, 1.0), 1425.);
-
-    Material blue_rubber(red_rubber.RefractiveIndex, red_rubber.Albedo,
-        Vec3f(0.1, 0.1, 0.3), red_rubber.SpecularExponent);
-
-    // walls
-    renderer.Shapes.push_back(new Plane(Vec3f(-6,0,-20), Vec3f(1,0,0).Normalize(), 
-        ivory));
-    renderer.Shapes.push_back(new Plane(Vec3f(5,0,-15), Vec3f(0,0,1).Normalize(), 
-        red_rubber));
-    renderer.Shapes.push_back(new Plane(Vec3f(0,-4,0), Vec3f(0,1,0).Normalize(), 
-        blue_rubber));
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
 
-    // shapes
-    // renderer.Shapes.push_back(new Circle(Vec3f(-3,0,-10), 2, Vec3f(0,1,1).Normalize(), 
-    //    ivory));
-    renderer.Shapes.push_back(new Rectangle(Vec3f(3,2,-6), 2, 2, Vec3f(0,0,1).Normalize(), 
-        ivory));
-    renderer.Shapes.push_back(new Sphere(Vec3f(3,5,-10), 2, 
-        mirror));
-    // renderer.Shapes.push_back(new Ellipse(Vec3f(6,0,-10), Vec3f(6,0,-10), 1, Vec3f(0,0,1).Normalize(), 
-    //    ivory));
+// The animation is saved to "output.gif" or the file given with --output. Files ending with
+// ".y4m" and ".rgba" get uncompressed video instead of a GIF. "-" writes Y4M to the standard
+// output, so it can be piped to a video encoder. The scene is loaded from the file given with
+// --scene (see SceneFile) instead of being the demo scene. --still saves a single frame as an
+// image of any size (see BandRenderer) instead. See CommandLine for all options.
+int main(int argc, char *argv[])
+{
+    CommandLine options;
+    std::string error;
+    if(!options.Parse(argc, argv, error))
+    {
+        std::cerr << error << '\n';
+        CommandLine::PrintUsage(std::cerr);
+        return 2;
+    }
+    if(options.Help)
+    {
+        CommandLine::PrintUsage(std::cout);
+        return 0;
+    }
+    // A still image is saved instead of the animation, if it is given.
+    const bool still = !options.Still.empty();
+    const std::string &outputName = still ? options.Still : options.Output;
+    const bool toStandardOutput = outputName == "-" || options.Timing == "-" || options.Trace == "-";
+    const bool video = outputName == "-" || EndsWith(outputName, ".y4m") || EndsWith(outputName, ".rgba");
+    // Messages do not mix with the video or the timing written to the standard output.
+    std::ostream &log = toStandardOutput ? std::cerr : std::cout;
 
-    renderer.Lights.push_back(new Light(Vec3f(-5, 10,  -1), 1.5));
-    renderer.Lights.push_back(new Light(Vec3f( 5, 10, -1), 1.8));
-    renderer.Lights.push_back(new Light(Vec3f( 5, 20,  -1), 1.7));
+    // started before any threads are created, so the spans of all of them are recorded
+    if(!options.Trace.empty())
+    {
+        Tracer::Start();
+        Tracer::NameThread("main");
+    }
 
-    // Negative angle rotates clockwise.
-    // renderer.Eye.RotateY(-M_PI / 2);
+    // Frames are rendered into the buffers of the pipeline below and the still image in bands,
+    // so the renderer does not need a frame buffer of its own.
+    Renderer renderer(options.Width, options.Height, (byte)options.Threads, false);
+    std::unique_ptr<DemoScene> demoScene;
+    SceneFile sceneFile;
+    if(options.Generate)
+        SceneGenerator((uint32_t)options.Seed).Generate(renderer, options.GeneratedKind, (uint32_t)options.GeneratedCount);
+    else if(!options.Scene.empty())
+    {
+        if(!sceneFile.Load(options.Scene, error))
+        {
+            std::cerr << options.Scene << ": " << error << '\n';
+            return 1;
+        }
+        sceneFile.Build(renderer);
+    }
+    else
+        demoScene.reset(new DemoScene(renderer));
 
-    renderer.Eye.Position.Z = 5;
+    // Frames are quantized by as many threads as the renderer uses.
+    GifParallelWriter writer(renderer.TotalThreads);
+    writer.UsePaletteLookup = true;
+    VideoWriter videoWriter;
+    const uint32_t delay = 20;
+    std::unique_ptr<ImageSaver> stillSaver;
+    std::unique_ptr<OutputSink> stillOutput;
+    if(still)
+    {
+        stillSaver = CreateImageSaver(outputName);
+        if(!stillSaver)
+        {
+            std::cerr << outputName << ": unknown image format\n";
+            CommandLine::PrintUsage(std::cerr);
+            return 2;
+        }
+        if(!stillSaver->CanSave(renderer.Width, renderer.Height))
+        {
+            std::cerr << outputName << ": the image is too large for the format\n";
+            return 2;
+        }
+        stillOutput = OpenOutputSink(outputName.c_str());
+    }
+    const bool opened = still ? stillOutput != nullptr : video ?
+        videoWriter.Begin(OpenOutputSink(outputName.c_str()), EndsWith(outputName, ".rgba") ?
+            VideoFormat::RawRGBA : VideoFormat::Y4M, renderer.Width, renderer.Height, delay) :
+        writer.Begin(outputName.c_str(), renderer.Width, renderer.Height, delay);
+    if(!opened)
+    {
+        std::cerr << "cannot open " << outputName << '\n';
+        return 1;
+    }
 
-    const uint32_t totalFrames = 16;
+    const uint32_t firstFrame = (uint32_t)options.FirstFrame,
+        lastFrame = firstFrame + (still ? 1 : (uint32_t)options.Frames);
     // const float rotationVelocity = M_PI * 1.f / (float) totalFrames;
     // const float rotationVelocity = M_PI / 180.f;
-    float targetX = -5.f / 2.f;
-    const float cameraVelocity = 1.f;
-    float velocity = -0.25f;
+    TimingReport timing;
+    const char *generatedNames[] = { "spheres", "rectangles", "ellipses", "lights" };
+    timing.Scene = options.Generate ? std::string(generatedNames[(int)options.GeneratedKind]) + ' ' +
+        std::to_string(options.GeneratedCount) + ' ' + std::to_string(options.Seed) :
+        options.Scene.empty() ? "demo" : options.Scene;
+    timing.Width = renderer.Width;
+    timing.Height = renderer.Height;
+    renderer.RecordCost = options.HeatmapCost;
+    Heatmap heatmap;
+    if(options.HeatmapTiles)
+    {
+        heatmap.TileWidth = renderer.TileWidth;
+        heatmap.TileHeight = renderer.TileHeight;
+    }
 
     std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-    //renderer.Eye.SetDirection(Vec3f(0,0,1));
-    //renderer.Eye.RotateY(-M_PI / 12.f);
-    Rectangle* r = (Rectangle*) renderer.Shapes[3];
-    r->SetDirection(Vec3f(1,1,0).Normalize());
-    Sphere* s = (Sphere*) renderer.Shapes[4];
-    for(uint32_t frameCounter = 0; frameCounter < totalFrames; ++frameCounter)
+    // Frames are encoded on another thread, while the next ones are rendered.
+    FramePipeline pipeline(still ? 0 : renderer.FrameSize(), 3, [&](const byte *frame)
     {
-        Vec3f dir = s->Center - renderer.Eye.Position;
-        renderer.Eye.SetDirection(dir.Normalize());
-        // renderer.Eye.SetDirection(Vec3f(targetX,targetX,-10).Normalize());
-        renderer.RenderFrame();
-        GifWriteFrame(&writer, renderer.FrameBuffer,
-            renderer.Width, renderer.Height, delay);
+        if(video)
+            videoWriter.WriteFrame(frame);
+        else
+            writer.WriteFrame(frame, renderer.Width, renderer.Height, delay);
+    });
+    bool stillWritten = false;
+    for(uint32_t frameCounter = 0; frameCounter < lastFrame; ++frameCounter)
+    {
+        if(demoScene)
+            demoScene->PrepareFrame();
+        else
+            sceneFile.PrepareFrame();
+        if(frameCounter >= firstFrame)
+        {
+            byte *const frame = still ? nullptr : pipeline.Acquire();
+            const std::chrono::steady_clock::time_point frameBegin = std::chrono::steady_clock::now();
+            if(still)
+                stillWritten = BandRenderer(options.BandHeight).Render(renderer, *stillSaver, *stillOutput);
+            else
+                renderer.RenderFrame(frame);
+            timing.AddFrame(frameCounter, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - frameBegin).count(), renderer);
+            if(renderer.RecordCost != PixelCost::None)
+                heatmap.Add(renderer.GetCostMap(), renderer.Width, renderer.Height);
+            pipeline.Submit();
+        }
         // renderer.Eye.RotateY(rotationVelocity);
-         //targetX += cameraVelocity;
-        
-        if(s->Center.Y - s->Radius <= 0)
-            velocity = -velocity;
-        else if(s->Center.Y + s->Radius >= 10)
-            velocity = -velocity;
-        s->Center.Y += velocity;
+        if(demoScene)
+            demoScene->Advance();
+        else
+            sceneFile.Advance();
     }
-    GifEnd(&writer);
+    pipeline.Finish();
+    const bool written = still ? stillOutput->Close() && stillWritten : video ? videoWriter.End() : writer.End();
 
     std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
 
     std::chrono::nanoseconds difference = end - begin;
+    timing.WallSeconds = std::chrono::duration<double>(difference).count();
 
-    std::cout << "resolution: " << renderer.Width << ' ' << renderer.Height << '\n' <<
+    log << "resolution: " << renderer.Width << ' ' << renderer.Height << '\n' <<
         "number of used threads: " << (int)renderer.TotalThreads << '\n' <<
         "elapsed time: \n" <<
         "seconds " << std::chrono::duration_cast<std::chrono::seconds>(difference).count() << '\n' <<
         "milliseconds " << std::chrono::duration_cast<std::chrono::milliseconds>(difference).count() << '\n' <<
         "microseconds " << std::chrono::duration_cast<std::chrono::microseconds>(difference).count() << '\n' <<
-        "nanoseconds " << std::chrono::duration_cast<std::chrono::nanoseconds>(difference).count() << '\n' <<
-        "press return to exit" << '\n';
-    std::getc(stdin);
+        "nanoseconds " << std::chrono::duration_cast<std::chrono::nanoseconds>(difference).count() << '\n';
+    // the counters are printed, if the program was built with RENDERER_COUNTERS=1
+    if(RayCounters::Enabled())
+    {
+        const RayCounters counters = timing.Total().Counters;
+        log << "rays: primary " << counters.PrimaryRays << ", reflected " << counters.ReflectionRays <<
+            ", refracted " << counters.RefractionRays << ", shadow " << counters.ShadowRays <<
+            " (blocked " << counters.BlockedShadowRays << ")\n" << "intersection tests:";
+        for(int type = 0; type < RayCounters::ShapeTypes; ++type)
+            log << ' ' << RayCounters::ShapeTypeName(type) << ' ' << counters.IntersectionTests[type];
+        log << '\n';
+    }
+    if(!written)
+        std::cerr << "cannot write " << outputName << '\n';
+    if(options.HeatmapCost != PixelCost::None)
+    {
+        // "output.gif" gets "output.heatmap.png", the standard output gets "heatmap.png"
+        std::string heatmapName = outputName == "-" ? "" : outputName;
+        const size_t dot = heatmapName.find_last_of('.');
+        if(dot != std::string::npos && heatmapName.find_first_of("/\\", dot) == std::string::npos)
+            heatmapName.erase(dot);
+        heatmapName += heatmapName.empty() ? "heatmap" : ".heatmap";
+        PNGSaver saver;
+        float maximumCost;
+        if(heatmap.Save(heatmapName, saver, maximumCost))
+            log << "heatmap: " << heatmapName << saver.Extension() << ", red is " << maximumCost <<
+                (options.HeatmapCost == PixelCost::Nanoseconds ? " ns" : " intersection tests") <<
+                (options.HeatmapTiles ? " per tile" : " per pixel") << " and frame or more (mean of " <<
+                heatmap.FrameCount() << " frames)\n";
+        else
+            std::cerr << "cannot write " << heatmapName << saver.Extension() << '\n';
+    }
+    if(!options.Timing.empty() && !timing.Write(options.Timing))
+    {
+        std::cerr << "cannot write " << options.Timing << '\n';
+        return 1;
+    }
+    if(!options.Trace.empty() && !Tracer::Write(options.Trace))
+    {
+        std::cerr << "cannot write " << options.Trace << '\n';
+        return 1;
+    }
+    // the standard input may be needed by the program reading the video
+    if(options.Wait && outputName != "-")
+    {
+        log << "press return to exit" << '\n';
+        std::getc(stdin);
+    }
 
-    return 0;
-}
\ No newline at end of file
+    return written ? 0 : 1;
+}
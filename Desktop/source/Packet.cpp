@@ -0,0 +1,211 @@
+#ifndef PACKET_CPP
+#define PACKET_CPP
+
+// Tracing of 4 coherent primary rays at once using SSE2. The packet path is compiled only
+// for targets, which have SSE2 intrinsics, and is used only if the CPU reports SSE2 support
+// at run time. Otherwise the renderer traces every ray on its own.
+
+#include <stdint.h>
+#include "../include/Vector.hpp"
+#include "Scene.cpp"
+
+#define RENDERER_PACKETS VECTOR_SIMD
+
+#if RENDERER_PACKETS
+// 4 rays leaving the same point, which is the case for primary rays.
+struct RayPacket
+{
+    Vec3f Origin;
+    Vec3f4 Direction, Inverse;
+};
+
+// Closest hits of the 4 rays of a packet. Lanes with Index[i] == UINT32_MAX hit nothing.
+struct PacketHit
+{
+    Float4 Distance;
+    uint32_t Index[4];
+    ShapeType Type[4];
+
+    // Records primitive i of the given type for the lanes set in mask.
+    void Record(const Float4 &mask, const Float4 &t, const uint32_t i, const ShapeType type)
+    {
+        Distance = Select(mask, t, Distance);
+        const int lanes = _mm_movemask_ps(mask.V);
+        for(int lane = 0; lane < 4; ++lane)
+            if(lanes & (1 << lane))
+            {
+                Index[lane] = i;
+                Type[lane] = type;
+            }
+    }
+};
+
+// Returns true, if any ray of the packet hits the box closer than its maxDistance.
+inline bool PacketHitsBox(const BoundingBox &box, const RayPacket &packet, const Float4 &maxDistance)
+{
+    const Float4 tx1 = Float4(box.Min.X - packet.Origin.X) * packet.Inverse.X,
+                 tx2 = Float4(box.Max.X - packet.Origin.X) * packet.Inverse.X;
+    Float4 tNear = Min(tx1, tx2), tFar = Max(tx1, tx2);
+    const Float4 ty1 = Float4(box.Min.Y - packet.Origin.Y) * packet.Inverse.Y,
+                 ty2 = Float4(box.Max.Y - packet.Origin.Y) * packet.Inverse.Y;
+    tNear = Max(tNear, Min(ty1, ty2));
+    tFar = Min(tFar, Max(ty1, ty2));
+    const Float4 tz1 = Float4(box.Min.Z - packet.Origin.Z) * packet.Inverse.Z,
+                 tz2 = Float4(box.Max.Z - packet.Origin.Z) * packet.Inverse.Z;
+    tNear = Max(tNear, Min(tz1, tz2));
+    tFar = Min(tFar, Max(tz1, tz2));
+    return Any((tFar >= Max(tNear, Float4(0.f))) & (tNear <= maxDistance));
+}
+
+// Calls visitLeaf(first, count) for every leaf, whose box is hit by any ray of the packet.
+template<class Visitor>
+void TraversePacket(const BoundingVolumeHierarchy &hierarchy, const RayPacket &packet,
+    const Float4 &maxDistance, Visitor visitLeaf)
+{
+    if(hierarchy.Nodes.empty())
+        return;
+    uint32_t stack[128];
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0)
+    {
+        const BoundingVolumeHierarchy::Node &node = hierarchy.Nodes[stack[--top]];
+        if(!PacketHitsBox(node.Bounds, packet, maxDistance))
+            continue;
+        if(node.Count > 0)
+            visitLeaf(node.First, node.Count);
+        else
+        {
+            stack[top++] = node.First + 1;
+            stack[top++] = node.First;
+        }
+    }
+}
+
+// The kernels below repeat the computations of the scalar kernels in Scene.cpp in the same
+// order, so a packet finds the same hits as 4 separate rays.
+
+inline void IntersectSpheres(const SphereArrays &spheres, const uint32_t first, const uint32_t end,
+    const RayPacket &packet, const float minDistance, PacketHit &hit)
+{
+    const Float4 minimum(minDistance), zero(0.f);
+    for(uint32_t i = first; i < end; ++i)
+    {
+        const float lx = spheres.CenterX[i] - packet.Origin.X, ly = spheres.CenterY[i] - packet.Origin.Y,
+                    lz = spheres.CenterZ[i] - packet.Origin.Z;
+        const Float4 tca = Vec3f4(Vec3f(lx, ly, lz)) * packet.Direction;
+        const Float4 d2 = Float4(lx*lx + ly*ly + lz*lz) - tca*tca, r2(spheres.RadiusSquared[i]);
+        const Float4 thc = Sqrt(Max(r2 - d2, zero));
+        const Float4 t0 = tca - thc, t1 = tca + thc;
+        const Float4 t = Select(t0 > minimum, t0, t1);
+        const Float4 closer = (d2 <= r2) & (t > minimum) & (t < hit.Distance);
+        if(Any(closer))
+            hit.Record(closer, t, i, ShapeType::Sphere);
+    }
+}
+
+inline Float4 PacketContains(const PlaneArrays &, const uint32_t, const Float4 &, const Float4 &, const Float4 &)
+{
+    return _mm_castsi128_ps(_mm_set1_epi32(-1));
+}
+inline Float4 PacketContains(const CircleArrays &circles, const uint32_t i,
+    const Float4 &x, const Float4 &y, const Float4 &z)
+{
+    const Float4 fx = x - Float4(circles.CenterX[i]), fy = y - Float4(circles.CenterY[i]),
+                 fz = z - Float4(circles.CenterZ[i]);
+    return fx*fx + fy*fy + fz*fz <= Float4(circles.RadiusSquared[i]);
+}
+inline Float4 PacketContains(const RectangleArrays &rectangles, const uint32_t i,
+    const Float4 &x, const Float4 &y, const Float4 &z)
+{
+    const Float4 fx = x - Float4(rectangles.CenterX[i]), fy = y - Float4(rectangles.CenterY[i]),
+                 fz = z - Float4(rectangles.CenterZ[i]);
+    const Float4 horizontalLength = fx*Float4(rectangles.HorizontalX[i]) + fy*Float4(rectangles.HorizontalY[i]) +
+                                    fz*Float4(rectangles.HorizontalZ[i]),
+                 verticalLength = fx*Float4(rectangles.VerticalX[i]) + fy*Float4(rectangles.VerticalY[i]) +
+                                  fz*Float4(rectangles.VerticalZ[i]);
+    const Float4 halfWidth(rectangles.HalfWidth[i]), halfHeight(rectangles.HalfHeight[i]);
+    return (horizontalLength <= halfWidth) & (horizontalLength >= Float4(-rectangles.HalfWidth[i])) &
+        (verticalLength <= halfHeight) & (verticalLength >= Float4(-rectangles.HalfHeight[i]));
+}
+inline Float4 PacketContains(const EllipseArrays &ellipses, const uint32_t i,
+    const Float4 &x, const Float4 &y, const Float4 &z)
+{
+    const Float4 ax = x - Float4(ellipses.CenterX[i]), ay = y - Float4(ellipses.CenterY[i]),
+                 az = z - Float4(ellipses.CenterZ[i]),
+                 bx = x - Float4(ellipses.Focus2X[i]), by = y - Float4(ellipses.Focus2Y[i]),
+                 bz = z - Float4(ellipses.Focus2Z[i]);
+    return Sqrt(ax*ax + ay*ay + az*az) + Sqrt(bx*bx + by*by + bz*bz) <= Float4(ellipses.FocusDistanceSum[i]);
+}
+
+template<class Primitives>
+void IntersectPlanar(const Primitives &shapes, const uint32_t first, const uint32_t end,
+    const RayPacket &packet, const float minDistance, const ShapeType type, PacketHit &hit)
+{
+    const Float4 minimum(minDistance);
+    const Vec3f &o = packet.Origin;
+    for(uint32_t i = first; i < end; ++i)
+    {
+        const Float4 cosDd = Vec3f4(Vec3f(shapes.NormalX[i], shapes.NormalY[i], shapes.NormalZ[i])) * packet.Direction;
+        const Float4 t = Float4(shapes.NormalX[i]*(shapes.CenterX[i] - o.X) + shapes.NormalY[i]*(shapes.CenterY[i] - o.Y) +
+            shapes.NormalZ[i]*(shapes.CenterZ[i] - o.Z)) / cosDd;
+        Float4 closer = (t > minimum) & (t < hit.Distance);
+        if(!Any(closer))
+            continue;
+        closer = closer & PacketContains(shapes, i, Float4(o.X) + packet.Direction.X*t,
+            Float4(o.Y) + packet.Direction.Y*t, Float4(o.Z) + packet.Direction.Z*t);
+        if(Any(closer))
+            hit.Record(closer, t, i, type);
+    }
+}
+
+// Finds the closest hits of the packet's rays at distances in (minDistance, maxDistance),
+// the same way as CompiledScene::Intersect does for a single ray.
+inline void IntersectPacket(const CompiledScene &scene, const RayPacket &packet, const float minDistance,
+    const float maxDistance, PacketHit &hit, [[maybe_unused]] RayCounters &counters)
+{
+    hit.Distance = Float4(maxDistance);
+    for(int lane = 0; lane < 4; ++lane)
+        hit.Index[lane] = UINT32_MAX;
+    RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Plane], 4 * scene.Planes.Size());
+    IntersectPlanar(scene.Planes, 0, (uint32_t)scene.Planes.Size(), packet, minDistance, ShapeType::Plane, hit);
+    TraversePacket(scene.GetHierarchy(ShapeType::Sphere), packet, hit.Distance,
+        [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Sphere], 4 * count);
+            IntersectSpheres(scene.Spheres, first, first + count, packet, minDistance, hit);
+        });
+    TraversePacket(scene.GetHierarchy(ShapeType::Circle), packet, hit.Distance,
+        [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Circle], 4 * count);
+            IntersectPlanar(scene.Circles, first, first + count, packet, minDistance, ShapeType::Circle, hit);
+        });
+    TraversePacket(scene.GetHierarchy(ShapeType::Rectangle), packet, hit.Distance,
+        [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Rectangle], 4 * count);
+            IntersectPlanar(scene.Rectangles, first, first + count, packet, minDistance, ShapeType::Rectangle, hit);
+        });
+    TraversePacket(scene.GetHierarchy(ShapeType::Ellipse), packet, hit.Distance,
+        [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Ellipse], 4 * count);
+            IntersectPlanar(scene.Ellipses, first, first + count, packet, minDistance, ShapeType::Ellipse, hit);
+        });
+}
+#endif // RENDERER_PACKETS
+
+// Tells, if packets can be traced on the CPU, which runs the program.
+inline bool PacketTracingSupported()
+{
+#if RENDERER_PACKETS && (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#elif RENDERER_PACKETS
+    return true;
+#else
+    return false;
+#endif
+}
+#endif // PACKET_CPP
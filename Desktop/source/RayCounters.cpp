@@ -0,0 +1,57 @@
+#ifndef RAYCOUNTERS_CPP
+#define RAYCOUNTERS_CPP
+
+#include <stdint.h>
+#include "Shapes.cpp"
+
+// Counting rays and intersection tests in the hot paths costs a few percent of the rendering
+// time, so it is compiled only if RENDERER_COUNTERS is defined as 1, e.g. by adding
+// '-DRENDERER_COUNTERS=1' to the g++ commands in 'build.bat'. Otherwise RENDERER_COUNT
+// compiles to nothing and only the primary rays, which are counted per tile, are known.
+// Parameters, which are used only by RENDERER_COUNT, are marked [[maybe_unused]].
+#ifndef RENDERER_COUNTERS
+#define RENDERER_COUNTERS 0
+#endif
+
+#if RENDERER_COUNTERS
+#define RENDERER_COUNT(counters, counter, amount) ((counters).counter += (amount))
+#else
+#define RENDERER_COUNT(counters, counter, amount) ((void)0)
+#endif
+
+// Rays traced and intersection tests done by one thread, or by all of them after merging.
+struct RayCounters
+{
+    static const int ShapeTypes = (int)ShapeType::Ellipse + 1;
+
+    uint64_t PrimaryRays = 0, ReflectionRays = 0, RefractionRays = 0, ShadowRays = 0;
+    // Shadow rays, which hit a shape before reaching the light.
+    uint64_t BlockedShadowRays = 0;
+    // Tests of a ray against a primitive by ShapeType. A packet of 4 rays makes 4 tests.
+    uint64_t IntersectionTests[ShapeTypes] = {};
+
+    static bool Enabled() { return RENDERER_COUNTERS != 0; }
+
+    uint64_t Rays() const
+    {
+        return PrimaryRays + ReflectionRays + RefractionRays + ShadowRays;
+    }
+
+    void Add(const RayCounters &other)
+    {
+        PrimaryRays += other.PrimaryRays;
+        ReflectionRays += other.ReflectionRays;
+        RefractionRays += other.RefractionRays;
+        ShadowRays += other.ShadowRays;
+        BlockedShadowRays += other.BlockedShadowRays;
+        for(int i = 0; i < ShapeTypes; ++i)
+            IntersectionTests[i] += other.IntersectionTests[i];
+    }
+
+    static const char* ShapeTypeName(const int type)
+    {
+        static const char *names[ShapeTypes] = { "sphere", "cube", "circle", "plane", "rectangle", "ellipse" };
+        return names[type];
+    }
+};
+#endif // RAYCOUNTERS_CPP
@@ -5,10 +5,30 @@
 #include <cmath>
 #include <float.h>
 #include <vector>
-#include <thread>
-#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include "../include/Vector.hpp"
 #include "Shapes.cpp"
+#include "ThreadPool.cpp"
+#include "TileScheduler.cpp"
+#include "Tracer.cpp"
+#include "Scene.cpp"
+#include "Packet.cpp"
+
+// Work done by one thread of the renderer since Renderer::ResetStatistics.
+struct alignas(64) ThreadStatistics
+{
+    // Time spent rendering tiles, without waiting for the other threads.
+    uint64_t BusyNanoseconds = 0;
+    uint64_t Tiles = 0;
+    // Primary rays are always counted, the others only if RENDERER_COUNTERS is 1.
+    RayCounters Counters;
+};
+
+// What the renderer can record for every pixel, see Renderer::RecordCost. Intersection
+// tests are known only if RENDERER_COUNTERS is 1 (see RayCounters). Pixels traced together
+// in a packet get a quarter of its cost each.
+enum class PixelCost { None, Nanoseconds, IntersectionTests };
 
 class LocalCoordinateSystem
 {
@@ -97,7 +117,7 @@ private:
 
     public:
         Camera(uint32_t frameHeight = 512, float fieldOfView = M_PI / 3.f, 
-            const Vec3f &position = Vec3f(0,0,0)) : ScreenHeight(frameHeight), Position(position)
+            const Vec3f &position = Vec3f(0,0,0)) : Position(position), ScreenHeight(frameHeight)
         {
             SetFieldOfView(fieldOfView);
         }
@@ -139,21 +159,48 @@ private:
             this->LocalCoordinateSystem::SetDirection(direction);
             DirectionTimesDistance = Direction * ScreenDistance;
         }
+        // The vectors used by GetScreenPixelPosition, for generating several rays at once.
+        const Vec3f& GetHorizontalAxis() const { return HorizontalAxis; }
+        const Vec3f& GetVerticalAxis() const { return VerticalAxis; }
+        const Vec3f& GetDirectionTimesDistance() const { return DirectionTimesDistance; }
     };
 
 public:
     const int Width, Height;
+    // Width * Height RGBA pixels, or nullptr, if the renderer was created without it.
     byte *const FrameBuffer;
     const byte TotalThreads;
     std::vector<Shape*> Shapes;
     std::vector<Light*> Lights;
     Camera Eye;
+    // Dimensions of the tiles, into which every frame is cut for the threads.
+    int TileWidth, TileHeight;
+    // Rays do not see shapes farther than this distance.
+    float MaxDistance;
+    // Trace primary rays in packets of 4 using SIMD instructions. Enabled by default, if the
+    // CPU supports them.
+    bool UsePacketTracing;
+    // Rays reflected or refracted this many times are not traced, so they are black. The
+    // primary ray has depth 0.
+    byte MaxDepth;
+    // A reflected or refracted ray is traced only if its weight in the pixel's color, which
+    // is the product of the albedos along its path, is greater than this. 0 skips only rays,
+    // whose color would be multiplied by 0.
+    float MinContribution;
+    // Cost recorded for every pixel in the cost map, e.g. to find the shapes, which are
+    // expensive to render. Measuring the time of every pixel slows rendering down a little.
+    PixelCost RecordCost;
 
+    // Without its own frame buffer, the renderer can only render into the buffers passed to
+    // RenderFrame and RenderRows, e.g. to render images too large to be kept in memory.
     Renderer(const uint32_t frameWidth = 512, const uint32_t frameHeight = 512, 
-        const byte numberOfThreads = 8)
-        : Width(frameWidth), Height(frameHeight), TotalThreads(numberOfThreads),
-          FrameBuffer(new byte[Width * Height * 4]), // 4 bytes per pixel (RGBA)
-          Eye(frameHeight) {}
+        const byte numberOfThreads = 8, const bool allocateFrameBuffer = true)
+        : Width(frameWidth), Height(frameHeight),
+          FrameBuffer(allocateFrameBuffer ? new byte[FrameSize()] : nullptr), TotalThreads(numberOfThreads),
+          Eye(frameHeight), TileWidth(16), TileHeight(16), MaxDistance(1000.f),
+          UsePacketTracing(PacketTracingSupported()), MaxDepth(3), MinContribution(0.f),
+          RecordCost(PixelCost::None),
+          Workers(numberOfThreads), Tiles(numberOfThreads), Statistics(Workers.TotalThreads), SceneInvalid(true) {}
     ~Renderer()
     {
         if(FrameBuffer)
@@ -166,97 +213,277 @@ public:
                 delete Lights[i];
     }
 
+    // Size of a frame in bytes (4 bytes per pixel, RGBA).
+    size_t FrameSize() const
+    {
+        return (size_t)Width * Height * 4;
+    }
+
     void RenderFrame()
     {
-        WorkingThreads = TotalThreads;
-        int y = Height / 2;
-        const int deltaY = Height / TotalThreads;
-        for(int i = 0; i < TotalThreads - 1; ++i)
+        RenderFrame(FrameBuffer);
+    }
+    // Renders the frame into frameBuffer, which must have room for Width * Height RGBA
+    // pixels, instead of FrameBuffer.
+    void RenderFrame(byte *const frameBuffer)
+    {
+        TraceScope trace("RenderFrame");
+        CompileScene();
+        RenderRows(frameBuffer, 0, Height);
+    }
+
+    // Rendering a frame in parts: CompileScene once, then RenderRows for every part.
+    // Prepares the shapes for rendering. The scene is compiled again only, if shapes were
+    // added or removed since the last time or InvalidateScene was called, otherwise the
+    // compiled shapes are only moved to where their shapes are now. Shapes must not be
+    // changed until the frame is rendered.
+    void CompileScene()
+    {
+        TraceScope trace("CompileScene");
+        if(SceneInvalid || !Scene.IsCompiledFrom(Shapes))
         {
-            std::thread(&Renderer::RenderFramePart, this, y, y - deltaY).detach();
-            y -= deltaY;
+            Scene.Compile(Shapes);
+            SceneInvalid = false;
         }
-        RenderFramePart(y, y - deltaY);
-        while(WorkingThreads > 0);
+        else
+            Scene.Update();
+    }
+    // Makes the next CompileScene compile the scene again, which is needed after the
+    // material of a shape was changed or a shape was replaced by another one at the same
+    // address.
+    void InvalidateScene()
+    {
+        SceneInvalid = true;
+    }
+    // Renders rows [top, bottom) of the frame into band, which must have room for
+    // (bottom - top) * Width RGBA pixels. Row top is the first row of band.
+    void RenderRows(byte *const band, const int top, const int bottom)
+    {
+        Tiles.Reset(Width, top, bottom, TileWidth, TileHeight);
+        if(RecordCost != PixelCost::None)
+            CostMap.resize((size_t)Width * Height);
+        Workers.Run([this, band, top](const byte threadIndex)
+        {
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            Tracer::NameThread("renderer", threadIndex);
+            ThreadStatistics &statistics = Statistics[threadIndex];
+            Tile tile;
+            while(Tiles.Next(threadIndex, tile))
+            {
+                RenderFramePart(tile, band, top, statistics.Counters);
+                ++statistics.Tiles;
+                // one primary ray is traced for every pixel
+                statistics.Counters.PrimaryRays += (uint64_t)(tile.Right - tile.Left) * (tile.Bottom - tile.Top);
+            }
+            statistics.BusyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin).count();
+        });
+    }
+
+    // Single rays for tools and benchmarks, traced on the calling thread, which counts as
+    // thread 0 in the statistics. The scene must be compiled by CompileScene first and
+    // direction must be normalized.
+    // Color seen by the ray, including up to MaxDepth - 1 reflections and refractions.
+    Vec3f TraceRay(const Vec3f &origin, const Vec3f &direction)
+    {
+        return CastRay(origin, direction, Statistics[0].Counters);
+    }
+    // Finds the shape closest to origin along direction. Returns false, if the ray hits
+    // nothing closer than MaxDistance.
+    bool IntersectRay(const Vec3f &origin, const Vec3f &direction, HitRecord &hit)
+    {
+        return SceneIntersect(origin, direction, hit, Statistics[0].Counters);
+    }
+
+    // Work done by thread threadIndex (0 to TotalThreads - 1) since ResetStatistics. Must
+    // not be called while a frame is being rendered.
+    const ThreadStatistics& GetThreadStatistics(const byte threadIndex) const
+    {
+        return Statistics[threadIndex];
+    }
+    // Costs of the pixels (Width * Height values from the top-left corner) of the last
+    // rendered frame, if RecordCost is not PixelCost::None. Must not be read while a frame
+    // is being rendered.
+    const std::vector<float>& GetCostMap() const
+    {
+        return CostMap;
+    }
+
+    // Counters of all threads merged.
+    RayCounters GetCounters() const
+    {
+        RayCounters counters;
+        for(size_t i = 0; i < Statistics.size(); ++i)
+            counters.Add(Statistics[i].Counters);
+        return counters;
+    }
+    void ResetStatistics()
+    {
+        for(size_t i = 0; i < Statistics.size(); ++i)
+            Statistics[i] = ThreadStatistics();
     }
 
 private:
-    std::atomic<byte> WorkingThreads;
-    void RenderFramePart(int y, const int endY)
+    // Created once together with the renderer and reused by every RenderFrame call.
+    ThreadPool Workers;
+    TileScheduler Tiles;
+    // One per thread, on separate cache lines, so the threads do not slow each other down.
+    std::vector<ThreadStatistics> Statistics;
+    // Shapes compiled into per-type arrays and bounding volume hierarchies. Shapes may be
+    // moved between frames, so the compiled scene is updated at the beginning of every frame.
+    CompiledScene Scene;
+    bool SceneInvalid;
+    std::vector<float> CostMap;
+
+    // The cost of a pixel is the difference of the values returned before and after rendering it.
+    uint64_t MeasureCost(const RayCounters &counters) const
+    {
+        if(RecordCost == PixelCost::Nanoseconds)
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint64_t tests = 0;
+        for(int type = 0; type < RayCounters::ShapeTypes; ++type)
+            tests += counters.IntersectionTests[type];
+        return tests;
+    }
+
+    // band holds the rows from bandTop. The rays are counted in counters of the rendering
+    // thread.
+    void RenderFramePart(const Tile &tile, byte *const band, const int bandTop, RayCounters &counters)
     {
-        int x;
-        byte *p = FrameBuffer + 4 * Width * (Height / 2 - y); // offset
-        for( ; y > endY; --y) // going from top
+        TraceScope trace("RenderFramePart");
+        int x, y, row, column;
+        for(row = tile.Top; row < tile.Bottom; ++row) // going from top
         {
-            for(x = -Width / 2; x < Width / 2; ++x) // going from left
+            byte *p = band + 4 * ((size_t)Width * (row - bandTop) + tile.Left); // offset
+            y = Height / 2 - row;
+            column = tile.Left;
+            // costs of the row's pixels, if they are recorded
+            float *const cost = RecordCost != PixelCost::None ? CostMap.data() + (size_t)Width * row : nullptr;
+#if RENDERER_PACKETS
+            if(UsePacketTracing && MaxDepth > 0)
+                for( ; column + 4 <= tile.Right; column += 4, p += 16)
+                {
+                    const uint64_t start = cost ? MeasureCost(counters) : 0;
+                    RenderPacket(column - Width / 2, y, p, counters);
+                    if(cost)
+                        std::fill(cost + column, cost + column + 4, (MeasureCost(counters) - start) / 4.f);
+                }
+#endif
+            for( ; column < tile.Right; ++column) // going from left
             {
-                Vec3b color = static_cast<Vec3b>(CastRay(Eye.Position, Eye.GetScreenPixelPosition(x, y).Normalize()));
+                const uint64_t start = cost ? MeasureCost(counters) : 0;
+                x = column - Width / 2;
+                Vec3b color = static_cast<Vec3b>(CastRay(Eye.Position, Eye.GetScreenPixelPosition(x, y).Normalize(), counters));
                 *p = color.R; ++p;
                 *p = color.G; ++p;
                 *p = color.B; ++p;
-                ++p;
+                *p = 255; ++p;
+                if(cost)
+                    cost[column] = (float)(MeasureCost(counters) - start);
                 // Adding 4, because every pixel is coded by four bytes. The fourth byte is 
-                // alpha value, which is ignored by GifWriter.
+                // alpha value, which is ignored by GifWriter. It is set, so the frame can be
+                // saved as RGBA.
             }
         }
-        --WorkingThreads;
     }
 
-    bool SceneIntersect(const Vec3f &orig, const Vec3f &dir, Vec3f &closestShapeHitPoint, 
-        Vec3f &closestShapeNormal, Material &material)
+#if RENDERER_PACKETS
+    // Traces the primary rays of pixels (x, y)...(x + 3, y) together and writes their
+    // colors to p. Secondary rays are traced one by one.
+    void RenderPacket(const int x, const int y, byte *p, RayCounters &counters)
     {
-        byte i;
-        float closestShapeDistance = FLT_MAX, distance;
-        Vec3f normal, hitPoint;
-        for(i = 0; i < Shapes.size(); ++i)
+        const Vec3f &h = Eye.GetHorizontalAxis(), &v = Eye.GetVerticalAxis(),
+            &d = Eye.GetDirectionTimesDistance();
+        // Eye.GetScreenPixelPosition(x + i, y).Normalize() for every lane i
+        const Float4 xs(_mm_setr_ps((float)x, (float)(x + 1), (float)(x + 2), (float)(x + 3)));
+        const float fy = (float)y;
+        RayPacket packet;
+        packet.Origin = Eye.Position;
+        packet.Direction = (Vec3f4(h) * xs + Vec3f4(v * fy) + Vec3f4(d)).Normalize();
+        packet.Inverse = Vec3f4(Float4(1.f) / packet.Direction.X, Float4(1.f) / packet.Direction.Y,
+            Float4(1.f) / packet.Direction.Z);
+
+        PacketHit packetHit;
+        IntersectPacket(Scene, packet, 0.f, MaxDistance, packetHit, counters);
+
+        float distances[4];
+        packetHit.Distance.Store(distances);
+        for(int lane = 0; lane < 4; ++lane)
         {
-            if(Shapes[i]->RayIntersect(orig, dir, distance, hitPoint, normal) &&
-                distance < closestShapeDistance)
+            Vec3f color(0.f, 0.f, 0.f); // background color
+            if(packetHit.Index[lane] != UINT32_MAX)
             {
-                closestShapeDistance = distance;
-                closestShapeHitPoint = hitPoint;
-                closestShapeNormal = normal;
-                material = Shapes[i]->Surface;
+                HitRecord hit;
+                hit.Distance = distances[lane];
+                hit.Index = packetHit.Index[lane];
+                hit.Type = packetHit.Type[lane];
+                color = Shade(Eye.Position, packet.Direction.Lane(lane), hit, counters, 0, 1.f);
             }
+            const Vec3b c = static_cast<Vec3b>(color);
+            p[4 * lane] = c.R;
+            p[4 * lane + 1] = c.G;
+            p[4 * lane + 2] = c.B;
+            p[4 * lane + 3] = 255;
         }
-        return closestShapeDistance < 1000;
     }
+#endif
 
-    bool SceneIntersect(const Vec3f &orig, const Vec3f &dir, Vec3f &closestShapeHitPoint, 
-        Vec3f &closestShapeNormal)
+    // Finds the shape closest to orig along dir. Returns false, if the ray hits nothing
+    // closer than MaxDistance.
+    bool SceneIntersect(const Vec3f &orig, const Vec3f &dir, HitRecord &hit, RayCounters &counters) const
     {
-        byte i;
-        float closestShapeDistance = FLT_MAX, distance;
-        Vec3f normal, hitPoint;
-        for(i = 0; i < Shapes.size(); ++i)
-        {
-            if(Shapes[i]->RayIntersect(orig, dir, distance, hitPoint, normal) &&
-                distance < closestShapeDistance)
-            {
-                closestShapeDistance = distance;
-                closestShapeHitPoint = hitPoint;
-                closestShapeNormal = normal;
-            }
-        }
-        return closestShapeDistance < 1000;
+        return Scene.Intersect(orig, dir, 0.f, MaxDistance, hit, counters);
     }
 
-    Vec3f CastRay(const Vec3f &orig, const Vec3f &dir, const byte depth = 0)
+    // Any-hit query used for shadow rays. Returns true as soon as any shape is found
+    // between orig and the point at maxDistance along dir.
+    bool Occluded(const Vec3f &orig, const Vec3f &dir, const float maxDistance, RayCounters &counters) const
     {
-        Vec3f point, N;
-        Material material;
+        return Scene.Occluded(orig, dir, maxDistance, counters);
+    }
 
-        if (depth>=3 || !SceneIntersect(orig, dir, point, N, material))
+    // weight is the factor, by which the returned color is multiplied in the pixel's color.
+    Vec3f CastRay(const Vec3f &orig, const Vec3f &dir, RayCounters &counters, const byte depth = 0,
+        const float weight = 1.f)
+    {
+        HitRecord hit;
+        if (depth>=MaxDepth || !SceneIntersect(orig, dir, hit, counters))
             return Vec3f(0.f, 0.f, 0.f); // background color
+        return Shade(orig, dir, hit, counters, depth, weight);
+    }
+
+    // Color seen by the ray, which hit the scene as described by hit.
+    Vec3f Shade(const Vec3f &orig, const Vec3f &dir, const HitRecord &hit, RayCounters &counters,
+        const byte depth, const float weight)
+    {
+        // the hit point, the normal and the material are only needed for the closest shape
+        const Vec3f point = orig + hit.Distance * dir;
+        const Vec3f N = Scene.Normal(hit, orig, dir, point);
+        const Material &material = Scene.GetMaterial(hit);
 
-        Vec3f reflect_dir = reflect(dir, N).Normalize();
-        Vec3f refract_dir = refract(dir, N, material.RefractiveIndex).Normalize();
-        // Vec3f reflect_orig = reflect_dir*N < 0 ? point - N*1e-3 : point + N*1e-3; // offset the original point to avoid occlusion by the object itself
-        Vec3f reflect_orig = point + N*1e-3;
-        // Vec3f refract_orig = refract_dir*N < 0 ? point - N*1e-3 : point + N*1e-3;
-        Vec3f refract_orig = point - N*1e-3;
-        Vec3f reflect_color = CastRay(reflect_orig, reflect_dir, depth + 1);
-        Vec3f refract_color = CastRay(refract_orig, refract_dir, depth + 1);
+        // Secondary rays are traced only if they can still change the pixel's color.
+        Vec3f reflect_color, refract_color;
+        const float reflect_weight = weight * material.Albedo[2], refract_weight = weight * material.Albedo[3];
+        if (depth + 1 < MaxDepth && reflect_weight > MinContribution)
+        {
+            Vec3f reflect_dir = reflect(dir, N).Normalize();
+            // Vec3f reflect_orig = reflect_dir*N < 0 ? point - N*1e-3 : point + N*1e-3; // offset the original point to avoid occlusion by the object itself
+            Vec3f reflect_orig = point + N*1e-3;
+            RENDERER_COUNT(counters, ReflectionRays, 1);
+            reflect_color = CastRay(reflect_orig, reflect_dir, counters, depth + 1, reflect_weight);
+        }
+        Vec3f refract_dir;
+        // on total internal reflection, there is no refracted ray
+        if (depth + 1 < MaxDepth && refract_weight > MinContribution &&
+            TryRefract(dir, N, material.RefractiveIndex, 1.f, refract_dir))
+        {
+            refract_dir.Normalize();
+            // Vec3f refract_orig = refract_dir*N < 0 ? point - N*1e-3 : point + N*1e-3;
+            Vec3f refract_orig = point - N*1e-3;
+            RENDERER_COUNT(counters, RefractionRays, 1);
+            refract_color = CastRay(refract_orig, refract_dir, counters, depth + 1, refract_weight);
+        }
 
         float diffuse_light_intensity = 0, specular_light_intensity = 0;
         for (size_t i=0; i < Lights.size(); i++)
@@ -265,10 +492,12 @@ private:
             float light_distance = light_dir.NormalizeReturnNorm();
 
             Vec3f shadow_orig = light_dir*N < 0 ? point - N*1e-3 : point + N*1e-3; // checking if the point lies in the shadow of the Lights[i]
-            Vec3f shadow_pt, shadow_N;
-            if (SceneIntersect(shadow_orig, light_dir, shadow_pt, shadow_N) 
-                && (shadow_pt-shadow_orig).Norm() < light_distance)
+            RENDERER_COUNT(counters, ShadowRays, 1);
+            if (Occluded(shadow_orig, light_dir, std::min(light_distance, MaxDistance), counters))
+            {
+                RENDERER_COUNT(counters, BlockedShadowRays, 1);
                 continue;
+            }
 
             diffuse_light_intensity  += Lights[i]->Intensity * std::max(0.f, light_dir*N);
             specular_light_intensity += powf(std::max(0.f, -reflect(-light_dir, N)*dir), 
@@ -0,0 +1,618 @@
+#ifndef SCENE_CPP
+#define SCENE_CPP
+
+#include <vector>
+#include <unordered_map>
+#include <array>
+#include <cstring>
+#include <stdint.h>
+#include "../include/Vector.hpp"
+#include "Shapes.cpp"
+#include "BVH.cpp"
+#include "RayCounters.cpp"
+
+// The result of a closest-hit query. Only the distance and the primitive are recorded during
+// traversal, the hit point and the normal are computed afterwards for the closest primitive.
+struct HitRecord
+{
+    float Distance;
+    // Index into the arrays of the primitive type given by Type.
+    uint32_t Index;
+    ShapeType Type;
+};
+
+// Reorders values, so that values[i] becomes the old values[order[i]].
+template<class T>
+void PermuteArray(std::vector<T> &values, const std::vector<uint32_t> &order)
+{
+    std::vector<T> permuted(order.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        permuted[i] = values[order[i]];
+    values.swap(permuted);
+}
+
+/* Every primitive type below keeps its data as a structure of arrays, so its kernels walk
+contiguous float arrays without pointer chasing nor virtual calls. The kernels are written
+without early exits, so the compiler can vectorize them.
+Intersect tests primitives [first, end) and, if one of them is hit at a distance in
+(minDistance, distance), stores the closest such hit in distance and index.
+Occluded returns true, if any of the primitives [first, end) is hit in (0, maxDistance).
+Update reads the geometry of the i-th primitive again from its shape, which has moved. */
+
+struct SphereArrays
+{
+    std::vector<float> CenterX, CenterY, CenterZ, RadiusSquared;
+    std::vector<uint32_t> MaterialId;
+
+    size_t Size() const { return MaterialId.size(); }
+    void Clear()
+    {
+        CenterX.clear(); CenterY.clear(); CenterZ.clear(); RadiusSquared.clear();
+        MaterialId.clear();
+    }
+    void Add(const Sphere &sphere, const uint32_t materialId)
+    {
+        CenterX.push_back(sphere.Center.X);
+        CenterY.push_back(sphere.Center.Y);
+        CenterZ.push_back(sphere.Center.Z);
+        RadiusSquared.push_back(sphere.Radius * sphere.Radius);
+        MaterialId.push_back(materialId);
+    }
+    void Update(const uint32_t i, const Sphere &sphere)
+    {
+        CenterX[i] = sphere.Center.X;
+        CenterY[i] = sphere.Center.Y;
+        CenterZ[i] = sphere.Center.Z;
+        RadiusSquared[i] = sphere.Radius * sphere.Radius;
+    }
+    void Permute(const std::vector<uint32_t> &order)
+    {
+        PermuteArray(CenterX, order); PermuteArray(CenterY, order); PermuteArray(CenterZ, order);
+        PermuteArray(RadiusSquared, order);
+        PermuteArray(MaterialId, order);
+    }
+
+    // Distance along the ray to the nearest intersection with the sphere farther than
+    // minDistance or a negative value, if there is none.
+    float Distance(const uint32_t i, const Vec3f &origin, const Vec3f &direction, const float minDistance) const
+    {
+        const float lx = CenterX[i] - origin.X, ly = CenterY[i] - origin.Y, lz = CenterZ[i] - origin.Z;
+        const float tca = lx*direction.X + ly*direction.Y + lz*direction.Z;
+        const float d2 = (lx*lx + ly*ly + lz*lz) - tca*tca;
+        const float thc = sqrtf(std::max(RadiusSquared[i] - d2, 0.f));
+        const float t0 = tca - thc, t1 = tca + thc;
+        const float t = t0 > minDistance ? t0 : t1;
+        return d2 <= RadiusSquared[i] ? t : -1.f;
+    }
+    bool Intersect(const uint32_t first, const uint32_t end, const Vec3f &origin, const Vec3f &direction,
+        const float minDistance, float &distance, uint32_t &index) const
+    {
+        bool found = false;
+        for(uint32_t i = first; i < end; ++i)
+        {
+            const float t = Distance(i, origin, direction, minDistance);
+            const bool closer = t > minDistance && t < distance;
+            distance = closer ? t : distance;
+            index = closer ? i : index;
+            found |= closer;
+        }
+        return found;
+    }
+    bool Occluded(const uint32_t first, const uint32_t end, const Vec3f &origin, const Vec3f &direction,
+        const float maxDistance) const
+    {
+        bool occluded = false;
+        for(uint32_t i = first; i < end; ++i)
+        {
+            const float t = Distance(i, origin, direction, 0.f);
+            occluded |= t > 0.f && t < maxDistance;
+        }
+        return occluded;
+    }
+    Vec3f Normal(const uint32_t i, const Vec3f &origin, const Vec3f &hitPoint) const
+    {
+        const Vec3f center(CenterX[i], CenterY[i], CenterZ[i]), L = center - origin;
+        if(L*L >= RadiusSquared[i])
+            return (hitPoint - center).Normalize();
+        else // the ray comes from the inside of the sphere
+            return (center - hitPoint).Normalize();
+    }
+};
+
+// Data shared by all planar primitives: a point on the plane and the plane's normal.
+struct PlanarArrays
+{
+    std::vector<float> CenterX, CenterY, CenterZ, NormalX, NormalY, NormalZ;
+    std::vector<uint32_t> MaterialId;
+
+    size_t Size() const { return MaterialId.size(); }
+    void Clear()
+    {
+        CenterX.clear(); CenterY.clear(); CenterZ.clear();
+        NormalX.clear(); NormalY.clear(); NormalZ.clear();
+        MaterialId.clear();
+    }
+    void Add(const PlainShape &shape, const uint32_t materialId)
+    {
+        CenterX.push_back(shape.Center.X);
+        CenterY.push_back(shape.Center.Y);
+        CenterZ.push_back(shape.Center.Z);
+        NormalX.push_back(shape.GetDirection().X);
+        NormalY.push_back(shape.GetDirection().Y);
+        NormalZ.push_back(shape.GetDirection().Z);
+        MaterialId.push_back(materialId);
+    }
+    void Update(const uint32_t i, const PlainShape &shape)
+    {
+        CenterX[i] = shape.Center.X;
+        CenterY[i] = shape.Center.Y;
+        CenterZ[i] = shape.Center.Z;
+        NormalX[i] = shape.GetDirection().X;
+        NormalY[i] = shape.GetDirection().Y;
+        NormalZ[i] = shape.GetDirection().Z;
+    }
+    void Permute(const std::vector<uint32_t> &order)
+    {
+        PermuteArray(CenterX, order); PermuteArray(CenterY, order); PermuteArray(CenterZ, order);
+        PermuteArray(NormalX, order); PermuteArray(NormalY, order); PermuteArray(NormalZ, order);
+        PermuteArray(MaterialId, order);
+    }
+
+    // Distance along the ray to the plane of the i-th primitive. It is infinite or NaN,
+    // if the ray is parallel to the plane.
+    float PlaneDistance(const uint32_t i, const Vec3f &origin, const Vec3f &direction) const
+    {
+        const float cosDd = NormalX[i]*direction.X + NormalY[i]*direction.Y + NormalZ[i]*direction.Z;
+        return (NormalX[i]*(CenterX[i] - origin.X) + NormalY[i]*(CenterY[i] - origin.Y) +
+            NormalZ[i]*(CenterZ[i] - origin.Z)) / cosDd;
+    }
+    Vec3f Normal(const uint32_t i, const Vec3f &direction) const
+    {
+        const Vec3f normal(NormalX[i], NormalY[i], NormalZ[i]);
+        if(normal*direction < 0) // the ray comes from the side of the shape that is pointed by its normal
+            return normal;
+        else // the ray comes from the other side of the shape
+            return -normal;
+    }
+};
+
+// Generic kernels for planar primitives. Primitives::Contains(i, x, y, z) tells, if the point
+// of the i-th primitive's plane lies inside the primitive.
+template<class Primitives>
+bool IntersectPlanar(const Primitives &shapes, const uint32_t first, const uint32_t end, const Vec3f &origin,
+    const Vec3f &direction, const float minDistance, float &distance, uint32_t &index)
+{
+    bool found = false;
+    for(uint32_t i = first; i < end; ++i)
+    {
+        const float t = shapes.PlaneDistance(i, origin, direction);
+        const bool closer = t > minDistance && t < distance && shapes.Contains(i,
+            origin.X + direction.X*t, origin.Y + direction.Y*t, origin.Z + direction.Z*t);
+        distance = closer ? t : distance;
+        index = closer ? i : index;
+        found |= closer;
+    }
+    return found;
+}
+template<class Primitives>
+bool OccludedPlanar(const Primitives &shapes, const uint32_t first, const uint32_t end, const Vec3f &origin,
+    const Vec3f &direction, const float maxDistance)
+{
+    bool occluded = false;
+    for(uint32_t i = first; i < end; ++i)
+    {
+        const float t = shapes.PlaneDistance(i, origin, direction);
+        occluded |= t > 0.f && t < maxDistance && shapes.Contains(i,
+            origin.X + direction.X*t, origin.Y + direction.Y*t, origin.Z + direction.Z*t);
+    }
+    return occluded;
+}
+
+struct PlaneArrays : public PlanarArrays
+{
+    bool Contains(const uint32_t, const float, const float, const float) const { return true; }
+    void Add(const Plane &plane, const uint32_t materialId) { PlanarArrays::Add(plane, materialId); }
+    void Update(const uint32_t i, const Plane &plane) { PlanarArrays::Update(i, plane); }
+};
+
+struct CircleArrays : public PlanarArrays
+{
+    std::vector<float> RadiusSquared;
+
+    void Clear() { PlanarArrays::Clear(); RadiusSquared.clear(); }
+    void Add(const Circle &circle, const uint32_t materialId)
+    {
+        PlanarArrays::Add(circle, materialId);
+        RadiusSquared.push_back(circle.Radius * circle.Radius);
+    }
+    void Update(const uint32_t i, const Circle &circle)
+    {
+        PlanarArrays::Update(i, circle);
+        RadiusSquared[i] = circle.Radius * circle.Radius;
+    }
+    void Permute(const std::vector<uint32_t> &order)
+    {
+        PlanarArrays::Permute(order);
+        PermuteArray(RadiusSquared, order);
+    }
+    bool Contains(const uint32_t i, const float x, const float y, const float z) const
+    {
+        const float fx = x - CenterX[i], fy = y - CenterY[i], fz = z - CenterZ[i];
+        return fx*fx + fy*fy + fz*fz <= RadiusSquared[i];
+    }
+};
+
+struct RectangleArrays : public PlanarArrays
+{
+    std::vector<float> HorizontalX, HorizontalY, HorizontalZ, VerticalX, VerticalY, VerticalZ,
+        HalfWidth, HalfHeight;
+
+    void Clear()
+    {
+        PlanarArrays::Clear();
+        HorizontalX.clear(); HorizontalY.clear(); HorizontalZ.clear();
+        VerticalX.clear(); VerticalY.clear(); VerticalZ.clear();
+        HalfWidth.clear(); HalfHeight.clear();
+    }
+    void Add(const Rectangle &rectangle, const uint32_t materialId)
+    {
+        PlanarArrays::Add(rectangle, materialId);
+        HorizontalX.push_back(rectangle.GetHorizontalAxis().X);
+        HorizontalY.push_back(rectangle.GetHorizontalAxis().Y);
+        HorizontalZ.push_back(rectangle.GetHorizontalAxis().Z);
+        VerticalX.push_back(rectangle.GetVerticalAxis().X);
+        VerticalY.push_back(rectangle.GetVerticalAxis().Y);
+        VerticalZ.push_back(rectangle.GetVerticalAxis().Z);
+        HalfWidth.push_back(rectangle.Width / 2.f);
+        HalfHeight.push_back(rectangle.Height / 2.f);
+    }
+    void Update(const uint32_t i, const Rectangle &rectangle)
+    {
+        PlanarArrays::Update(i, rectangle);
+        HorizontalX[i] = rectangle.GetHorizontalAxis().X;
+        HorizontalY[i] = rectangle.GetHorizontalAxis().Y;
+        HorizontalZ[i] = rectangle.GetHorizontalAxis().Z;
+        VerticalX[i] = rectangle.GetVerticalAxis().X;
+        VerticalY[i] = rectangle.GetVerticalAxis().Y;
+        VerticalZ[i] = rectangle.GetVerticalAxis().Z;
+        HalfWidth[i] = rectangle.Width / 2.f;
+        HalfHeight[i] = rectangle.Height / 2.f;
+    }
+    void Permute(const std::vector<uint32_t> &order)
+    {
+        PlanarArrays::Permute(order);
+        PermuteArray(HorizontalX, order); PermuteArray(HorizontalY, order); PermuteArray(HorizontalZ, order);
+        PermuteArray(VerticalX, order); PermuteArray(VerticalY, order); PermuteArray(VerticalZ, order);
+        PermuteArray(HalfWidth, order); PermuteArray(HalfHeight, order);
+    }
+    bool Contains(const uint32_t i, const float x, const float y, const float z) const
+    {
+        // see Rectangle::RayIntersect
+        const float fx = x - CenterX[i], fy = y - CenterY[i], fz = z - CenterZ[i];
+        const float horizontalLength = fx*HorizontalX[i] + fy*HorizontalY[i] + fz*HorizontalZ[i],
+                    verticalLength = fx*VerticalX[i] + fy*VerticalY[i] + fz*VerticalZ[i];
+        return horizontalLength <= HalfWidth[i] && horizontalLength >= -HalfWidth[i] &&
+            verticalLength <= HalfHeight[i] && verticalLength >= -HalfHeight[i];
+    }
+};
+
+struct EllipseArrays : public PlanarArrays
+{
+    std::vector<float> Focus2X, Focus2Y, Focus2Z, FocusDistanceSum;
+
+    void Clear()
+    {
+        PlanarArrays::Clear();
+        Focus2X.clear(); Focus2Y.clear(); Focus2Z.clear(); FocusDistanceSum.clear();
+    }
+    void Add(const Ellipse &ellipse, const uint32_t materialId)
+    {
+        PlanarArrays::Add(ellipse, materialId);
+        Focus2X.push_back(ellipse.Focus2.X);
+        Focus2Y.push_back(ellipse.Focus2.Y);
+        Focus2Z.push_back(ellipse.Focus2.Z);
+        FocusDistanceSum.push_back(ellipse.FocusDistanceSum);
+    }
+    void Update(const uint32_t i, const Ellipse &ellipse)
+    {
+        PlanarArrays::Update(i, ellipse);
+        Focus2X[i] = ellipse.Focus2.X;
+        Focus2Y[i] = ellipse.Focus2.Y;
+        Focus2Z[i] = ellipse.Focus2.Z;
+        FocusDistanceSum[i] = ellipse.FocusDistanceSum;
+    }
+    void Permute(const std::vector<uint32_t> &order)
+    {
+        PlanarArrays::Permute(order);
+        PermuteArray(Focus2X, order); PermuteArray(Focus2Y, order); PermuteArray(Focus2Z, order);
+        PermuteArray(FocusDistanceSum, order);
+    }
+    bool Contains(const uint32_t i, const float x, const float y, const float z) const
+    {
+        const float ax = x - CenterX[i], ay = y - CenterY[i], az = z - CenterZ[i],
+                    bx = x - Focus2X[i], by = y - Focus2Y[i], bz = z - Focus2Z[i];
+        return sqrtf(ax*ax + ay*ay + az*az) + sqrtf(bx*bx + by*by + bz*bz) <= FocusDistanceSum[i];
+    }
+};
+
+// Frozen representation of the renderer's shapes, which is traced instead of the Shape
+// objects. Shapes are compiled into per-type arrays with one bounding volume hierarchy per
+// bounded type, whose leaves are contiguous ranges of these arrays. Materials are
+// deduplicated and referenced by index. Compiling large scenes is slow, mostly because of
+// building the hierarchies, so shapes, which only moved, are read again by Update instead.
+class CompiledScene
+{
+public:
+    std::vector<Material> Materials;
+    SphereArrays Spheres;
+    CircleArrays Circles;
+    RectangleArrays Rectangles;
+    EllipseArrays Ellipses;
+    // Planes are unbounded, so they are tested against every ray.
+    PlaneArrays Planes;
+
+    void Compile(const std::vector<Shape*> &shapes)
+    {
+        Materials.clear();
+        MaterialIds.clear();
+        Spheres.Clear();
+        Circles.Clear();
+        Rectangles.Clear();
+        Ellipses.Clear();
+        Planes.Clear();
+        PlaneSources.clear();
+        for(int t = 0; t < BoundedTypes; ++t)
+        {
+            Bounds[t].clear();
+            Sources[t].clear();
+        }
+        CompiledShapes = shapes;
+
+        BoundingBox box;
+        for(size_t i = 0; i < shapes.size(); ++i)
+        {
+            const Shape &shape = *shapes[i];
+            const uint32_t materialId = AddMaterial(shape.Surface);
+            switch(shape.Type())
+            {
+            case ShapeType::Sphere:
+                Spheres.Add(static_cast<const Sphere&>(shape), materialId);
+                break;
+            case ShapeType::Circle:
+                Circles.Add(static_cast<const Circle&>(shape), materialId);
+                break;
+            case ShapeType::Rectangle:
+                Rectangles.Add(static_cast<const Rectangle&>(shape), materialId);
+                break;
+            case ShapeType::Ellipse:
+                Ellipses.Add(static_cast<const Ellipse&>(shape), materialId);
+                break;
+            case ShapeType::Plane:
+                Planes.Add(static_cast<const Plane&>(shape), materialId);
+                PlaneSources.push_back(&shape);
+                continue;
+            default: // cubes are never hit
+                continue;
+            }
+            shape.GetBounds(box);
+            Bounds[BoundedTypeIndex(shape.Type())].push_back(box);
+            Sources[BoundedTypeIndex(shape.Type())].push_back(&shape);
+        }
+
+        BuildHierarchy(Spheres, 0);
+        BuildHierarchy(Circles, 1);
+        BuildHierarchy(Rectangles, 2);
+        BuildHierarchy(Ellipses, 3);
+    }
+
+    // Returns true, if the scene was compiled from exactly these shapes in this order.
+    bool IsCompiledFrom(const std::vector<Shape*> &shapes) const
+    {
+        return shapes == CompiledShapes;
+    }
+
+    // Reads the geometry of the compiled shapes again, after they were moved or resized,
+    // and refits the hierarchies to their new bounding boxes. The hierarchies are not built
+    // again, so they get slower to traverse, the farther the shapes move from where they
+    // were compiled. Materials are read only by Compile.
+    void Update()
+    {
+        for(uint32_t i = 0; i < (uint32_t)PlaneSources.size(); ++i)
+            Planes.Update(i, static_cast<const Plane&>(*PlaneSources[i]));
+        Refit<Sphere>(Spheres, 0);
+        Refit<Circle>(Circles, 1);
+        Refit<Rectangle>(Rectangles, 2);
+        Refit<Ellipse>(Ellipses, 3);
+    }
+
+    // Finds the closest primitive hit at a distance in (minDistance, maxDistance). The tests
+    // are counted in counters.
+    bool Intersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, HitRecord &hit, [[maybe_unused]] RayCounters &counters) const
+    {
+        hit.Distance = maxDistance;
+        bool found = false;
+        uint32_t index;
+        // planes first, because walls usually give a close hit, which culls many boxes
+        RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Plane], Planes.Size());
+        if(IntersectPlanar(Planes, 0, (uint32_t)Planes.Size(), origin, direction, minDistance, hit.Distance, index))
+            Record(hit, index, ShapeType::Plane, found);
+        Hierarchies[0].Traverse(origin, direction, hit.Distance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Sphere], count);
+            if(Spheres.Intersect(first, first + count, origin, direction, minDistance, hit.Distance, index))
+                Record(hit, index, ShapeType::Sphere, found);
+            return false;
+        });
+        Hierarchies[1].Traverse(origin, direction, hit.Distance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Circle], count);
+            if(IntersectPlanar(Circles, first, first + count, origin, direction, minDistance, hit.Distance, index))
+                Record(hit, index, ShapeType::Circle, found);
+            return false;
+        });
+        Hierarchies[2].Traverse(origin, direction, hit.Distance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Rectangle], count);
+            if(IntersectPlanar(Rectangles, first, first + count, origin, direction, minDistance, hit.Distance, index))
+                Record(hit, index, ShapeType::Rectangle, found);
+            return false;
+        });
+        Hierarchies[3].Traverse(origin, direction, hit.Distance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Ellipse], count);
+            if(IntersectPlanar(Ellipses, first, first + count, origin, direction, minDistance, hit.Distance, index))
+                Record(hit, index, ShapeType::Ellipse, found);
+            return false;
+        });
+        return found;
+    }
+
+    // Returns true as soon as any primitive is hit in (0, maxDistance).
+    bool Occluded(const Vec3f &origin, const Vec3f &direction, const float maxDistance, [[maybe_unused]] RayCounters &counters) const
+    {
+        RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Plane], Planes.Size());
+        if(OccludedPlanar(Planes, 0, (uint32_t)Planes.Size(), origin, direction, maxDistance))
+            return true;
+        bool occluded = false;
+        Hierarchies[0].Traverse(origin, direction, maxDistance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Sphere], count);
+            return occluded = Spheres.Occluded(first, first + count, origin, direction, maxDistance);
+        });
+        if(occluded) return true;
+        Hierarchies[1].Traverse(origin, direction, maxDistance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Circle], count);
+            return occluded = OccludedPlanar(Circles, first, first + count, origin, direction, maxDistance);
+        });
+        if(occluded) return true;
+        Hierarchies[2].Traverse(origin, direction, maxDistance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Rectangle], count);
+            return occluded = OccludedPlanar(Rectangles, first, first + count, origin, direction, maxDistance);
+        });
+        if(occluded) return true;
+        Hierarchies[3].Traverse(origin, direction, maxDistance, [&](const uint32_t first, const uint32_t count)
+        {
+            RENDERER_COUNT(counters, IntersectionTests[(int)ShapeType::Ellipse], count);
+            return occluded = OccludedPlanar(Ellipses, first, first + count, origin, direction, maxDistance);
+        });
+        return occluded;
+    }
+
+    // Normal vector at hitPoint pointing to the side, from which the ray came.
+    Vec3f Normal(const HitRecord &hit, const Vec3f &origin, const Vec3f &direction, const Vec3f &hitPoint) const
+    {
+        switch(hit.Type)
+        {
+        case ShapeType::Sphere: return Spheres.Normal(hit.Index, origin, hitPoint);
+        case ShapeType::Circle: return Circles.Normal(hit.Index, direction);
+        case ShapeType::Rectangle: return Rectangles.Normal(hit.Index, direction);
+        case ShapeType::Ellipse: return Ellipses.Normal(hit.Index, direction);
+        default: return Planes.Normal(hit.Index, direction);
+        }
+    }
+
+    const Material& GetMaterial(const HitRecord &hit) const
+    {
+        switch(hit.Type)
+        {
+        case ShapeType::Sphere: return Materials[Spheres.MaterialId[hit.Index]];
+        case ShapeType::Circle: return Materials[Circles.MaterialId[hit.Index]];
+        case ShapeType::Rectangle: return Materials[Rectangles.MaterialId[hit.Index]];
+        case ShapeType::Ellipse: return Materials[Ellipses.MaterialId[hit.Index]];
+        default: return Materials[Planes.MaterialId[hit.Index]];
+        }
+    }
+
+    // Hierarchy over the primitives of a bounded type.
+    const BoundingVolumeHierarchy& GetHierarchy(const ShapeType type) const
+    {
+        return Hierarchies[BoundedTypeIndex(type)];
+    }
+
+private:
+    static const int BoundedTypes = 4;
+    BoundingVolumeHierarchy Hierarchies[BoundedTypes];
+    // Bounding boxes of the primitives, in the order they were added while compiling and in
+    // the order of the leaves while updating.
+    std::vector<BoundingBox> Bounds[BoundedTypes];
+    // Shapes, from which the scene was compiled, and those of every primitive in the order
+    // of the arrays.
+    std::vector<Shape*> CompiledShapes;
+    std::vector<const Shape*> Sources[BoundedTypes];
+    std::vector<const Shape*> PlaneSources;
+
+    // FNV-1a hash of the bits of the numbers of a material.
+    struct MaterialHash
+    {
+        size_t operator()(const std::array<float, 9> &key) const
+        {
+            uint32_t bits[9];
+            memcpy(bits, key.data(), sizeof(bits));
+            uint64_t hash = 14695981039346656037ull;
+            for(int i = 0; i < 9; ++i)
+                hash = (hash ^ bits[i]) * 1099511628211ull;
+            return (size_t)hash;
+        }
+    };
+    std::unordered_map<std::array<float, 9>, uint32_t, MaterialHash> MaterialIds;
+
+    static int BoundedTypeIndex(const ShapeType type)
+    {
+        switch(type)
+        {
+        case ShapeType::Sphere: return 0;
+        case ShapeType::Circle: return 1;
+        case ShapeType::Rectangle: return 2;
+        default: return 3; // ShapeType::Ellipse
+        }
+    }
+
+    static void Record(HitRecord &hit, const uint32_t index, const ShapeType type, bool &found)
+    {
+        hit.Index = index;
+        hit.Type = type;
+        found = true;
+    }
+
+    uint32_t AddMaterial(const Material &material)
+    {
+        const std::array<float, 9> key = { material.RefractiveIndex,
+            material.Albedo.X, material.Albedo.Y, material.Albedo.Z, material.Albedo.W,
+            material.DiffuseColor.X, material.DiffuseColor.Y, material.DiffuseColor.Z,
+            material.SpecularExponent };
+        const auto inserted = MaterialIds.insert(std::make_pair(key, (uint32_t)Materials.size()));
+        if(inserted.second)
+            Materials.push_back(material);
+        return inserted.first->second;
+    }
+
+    // Builds the hierarchy over the primitives of the type-th bounded type and puts them
+    // and their shapes in the order of its leaves.
+    template<class Primitives>
+    void BuildHierarchy(Primitives &primitives, const int type)
+    {
+        Hierarchies[type].Build(Bounds[type]);
+        primitives.Permute(Hierarchies[type].PrimitiveIndices);
+        PermuteArray(Sources[type], Hierarchies[type].PrimitiveIndices);
+    }
+
+    // Reads the primitives of the type-th bounded type, which are Kind shapes, again and
+    // refits its hierarchy.
+    template<class Kind, class Primitives>
+    void Refit(Primitives &primitives, const int type)
+    {
+        const std::vector<const Shape*> &sources = Sources[type];
+        std::vector<BoundingBox> &bounds = Bounds[type];
+        bounds.resize(sources.size());
+        for(uint32_t i = 0; i < (uint32_t)sources.size(); ++i)
+        {
+            primitives.Update(i, static_cast<const Kind&>(*sources[i]));
+            sources[i]->GetBounds(bounds[i]);
+        }
+        Hierarchies[type].Refit(bounds);
+    }
+};
+#endif // SCENE_CPP
@@ -0,0 +1,678 @@
+#ifndef SCENEFILE_CPP
+#define SCENEFILE_CPP
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+#include "../include/Vector.hpp"
+#include "../include/OutputSink.hpp"
+#include "Shapes.cpp"
+#include "Renderer.cpp"
+
+// Scenes (shapes, materials, lights, the camera and animation tracks) read from files
+// instead of being built in code.
+//
+// The text form has one item per line. Everything after '#' is a comment. Shapes refer to
+// materials by name and may be given a name as the last word, so the camera and the tracks
+// can refer to them. Directions do not have to be normalized.
+//   material NAME REFRACTIVE_INDEX ALBEDO0 ALBEDO1 ALBEDO2 ALBEDO3 R G B SPECULAR_EXPONENT
+//   light X Y Z INTENSITY
+//   camera X Y Z [direction X Y Z] [fov DEGREES] [target SHAPE]
+//   sphere X Y Z RADIUS MATERIAL [NAME]
+//   cube X Y Z EDGE MATERIAL [NAME]
+//   circle X Y Z RADIUS NX NY NZ MATERIAL [NAME]
+//   plane X Y Z NX NY NZ MATERIAL [NAME]
+//   rectangle X Y Z WIDTH HEIGHT NX NY NZ MATERIAL [NAME]
+//   ellipse X1 Y1 Z1 X2 Y2 Z2 EXTRA_DISTANCE NX NY NZ MATERIAL [NAME]
+//   key SHAPE|camera FRAME X Y Z
+// Keys move the center of a shape or the camera's position. Between keys, the position is
+// interpolated linearly, before the first and after the last key it does not change. A
+// camera with a target turns to the target's center in every frame.
+//
+// The binary form is a SceneFileHeader followed by arrays of the records below, which are
+// used straight from the mapped file, so loading it does not parse anything. It is made
+// by SaveBinary and uses the byte order of the machine, which made it.
+
+// A shape of any type. The meaning of the fields depends on Type:
+// - Sphere: Size[0] is the radius.
+// - Cube: Size[0] is the edge.
+// - Circle: Size[0] is the radius, Direction is the normal.
+// - Plane: Direction is the normal.
+// - Rectangle: Size[0] and Size[1] are the width and the height, Direction is the normal.
+// - Ellipse: Center and Point are the focuses, Size[0] is the extra distance, Direction is
+//   the normal.
+struct SceneShapeRecord
+{
+    uint32_t Type; // ShapeType
+    uint32_t Material; // index of the material
+    Vec3f Center, Direction, Point;
+    float Size[2];
+};
+
+struct SceneCameraRecord
+{
+    Vec3f Position, Direction;
+    float FieldOfView; // in radians
+    uint32_t Target; // index of the shape, which the camera looks at, or SceneNoTarget
+};
+
+// Keys [FirstKey, FirstKey + KeyCount) of the center of shape Target, or of the camera's
+// position, if Target is SceneNoTarget. Keys are sorted by Frame.
+struct SceneTrackRecord
+{
+    uint32_t Target, FirstKey, KeyCount;
+};
+
+struct SceneKeyRecord
+{
+    float Frame;
+    Vec3f Value;
+};
+
+struct SceneSection
+{
+    uint64_t Offset, Count;
+};
+
+struct SceneFileHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrder;
+    SceneCameraRecord Camera;
+    SceneSection Materials, Lights, Shapes, Tracks, Keys;
+};
+
+const uint32_t SceneNoTarget = UINT32_MAX;
+const char SceneFileMagic[8] = { '3', 'D', 'R', 'S', 'C', 'E', 'N', 'E' };
+const uint32_t SceneFileVersion = 1, SceneFileByteOrder = 0x01020304;
+
+// Material and Light are stored in the binary form as they are.
+static_assert(std::is_trivially_copyable<Material>::value && sizeof(Material) == 9 * sizeof(float), "Material must be plain floats");
+static_assert(std::is_trivially_copyable<Light>::value && sizeof(Light) == 4 * sizeof(float), "Light must be plain floats");
+static_assert(sizeof(SceneShapeRecord) == 13 * 4 && sizeof(SceneCameraRecord) == 8 * 4 &&
+    sizeof(SceneKeyRecord) == 4 * 4 && sizeof(SceneFileHeader) == 128, "scene records must not be padded");
+
+// A whole file in memory: mapped on POSIX systems, read elsewhere.
+class MappedFile
+{
+public:
+    MappedFile() : Data(nullptr), Size(0) {}
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char *path)
+    {
+        Close();
+#if OUTPUTSINK_POSIX
+        const int descriptor = open(path, O_RDONLY);
+        if(descriptor < 0)
+            return false;
+        const off_t size = lseek(descriptor, 0, SEEK_END);
+        if(size > 0)
+        {
+            void *memory = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(memory != MAP_FAILED)
+            {
+                Data = (const char*)memory;
+                Size = (size_t)size;
+            }
+        }
+        close(descriptor);
+        return size == 0 || Data != nullptr;
+#else
+        FILE *file = fopen(path, "rb");
+        if(!file)
+            return false;
+        char buffer[1 << 16];
+        for(size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0; )
+            Storage.insert(Storage.end(), buffer, buffer + read);
+        fclose(file);
+        Data = Storage.data();
+        Size = Storage.size();
+        return true;
+#endif
+    }
+    void Close()
+    {
+#if OUTPUTSINK_POSIX
+        if(Data)
+            munmap((void*)Data, Size);
+#else
+        Storage.clear();
+#endif
+        Data = nullptr;
+        Size = 0;
+    }
+    const char* GetData() const { return Data; }
+    size_t GetSize() const { return Size; }
+
+private:
+    const char *Data;
+    size_t Size;
+#if !OUTPUTSINK_POSIX
+    std::vector<char> Storage;
+#endif
+};
+
+class SceneFile
+{
+public:
+    SceneFile() : Camera(DefaultCamera()), Frame(0), Target(nullptr) {}
+
+    // Loads a scene in the text or the binary form. On failure, returns false and describes
+    // the problem in error.
+    bool Load(const std::string &path, std::string &error)
+    {
+        Clear();
+        if(!File.Open(path.c_str()))
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+        const bool binary = File.GetSize() >= sizeof(SceneFileMagic) &&
+            memcmp(File.GetData(), SceneFileMagic, sizeof(SceneFileMagic)) == 0;
+        const bool loaded = binary ? ViewBinary(error) : ParseText(error);
+        if(!loaded)
+            Clear();
+        // the text is not needed after parsing
+        if(!binary)
+            File.Close();
+        return loaded;
+    }
+
+    // Saves the loaded scene in the binary form. Returns false, if the file could not be
+    // written.
+    bool SaveBinary(const std::string &path) const
+    {
+        std::unique_ptr<OutputSink> output = OpenOutputSink(path.c_str());
+        if(!output)
+            return false;
+        SceneFileHeader header = SceneFileHeader();
+        memcpy(header.Magic, SceneFileMagic, sizeof(SceneFileMagic));
+        header.Version = SceneFileVersion;
+        header.ByteOrder = SceneFileByteOrder;
+        header.Camera = Camera;
+        uint64_t offset = sizeof(header);
+        header.Materials = Section(offset, Materials.Count, sizeof(Material));
+        header.Lights = Section(offset, Lights.Count, sizeof(Light));
+        header.Shapes = Section(offset, Shapes.Count, sizeof(SceneShapeRecord));
+        header.Tracks = Section(offset, Tracks.Count, sizeof(SceneTrackRecord));
+        header.Keys = Section(offset, Keys.Count, sizeof(SceneKeyRecord));
+        output->Write(&header, sizeof(header));
+        WriteSection(*output, Materials);
+        WriteSection(*output, Lights);
+        WriteSection(*output, Shapes);
+        WriteSection(*output, Tracks);
+        WriteSection(*output, Keys);
+        return output->Close();
+    }
+
+    // Adds the shapes and the lights to the renderer, which deletes them, and sets up its
+    // camera. The scene can be animated with PrepareFrame and Advance afterwards.
+    void Build(Renderer &renderer)
+    {
+        Target = &renderer;
+        Frame = 0;
+        BuiltShapes.clear();
+        BuiltShapes.reserve(Shapes.Count);
+        renderer.Shapes.reserve(renderer.Shapes.size() + Shapes.Count);
+        for(size_t i = 0; i < Shapes.Count; ++i)
+        {
+            Shape *shape = MakeShape(Shapes.Data[i]);
+            BuiltShapes.push_back(shape);
+            renderer.Shapes.push_back(shape);
+        }
+        for(size_t i = 0; i < Lights.Count; ++i)
+            renderer.Lights.push_back(new Light(Lights.Data[i]));
+
+        renderer.Eye.Position = Camera.Position;
+        renderer.Eye.SetFieldOfView(Camera.FieldOfView);
+        renderer.Eye.SetDirection(Vec3f(Camera.Direction).Normalize());
+    }
+
+    // Moves the shapes and the camera to their positions in the current frame. Called
+    // before rendering every frame, like DemoScene::PrepareFrame.
+    void PrepareFrame()
+    {
+        for(size_t i = 0; i < Tracks.Count; ++i)
+        {
+            const SceneTrackRecord &track = Tracks.Data[i];
+            const Vec3f value = Interpolate(Keys.Data + track.FirstKey, track.KeyCount, (float)Frame);
+            if(track.Target == SceneNoTarget)
+                Target->Eye.Position = value;
+            else
+                BuiltShapes[track.Target]->Center = value;
+        }
+        if(Camera.Target != SceneNoTarget)
+        {
+            Vec3f direction = BuiltShapes[Camera.Target]->Center - Target->Eye.Position;
+            Target->Eye.SetDirection(direction.Normalize());
+        }
+    }
+
+    // Goes to the next frame.
+    void Advance()
+    {
+        ++Frame;
+    }
+
+    // Number of frames, until the last key of any track.
+    uint32_t AnimationLength() const
+    {
+        float last = 0;
+        for(size_t i = 0; i < Tracks.Count; ++i)
+            if(Tracks.Data[i].KeyCount > 0)
+                last = std::max(last, Keys.Data[Tracks.Data[i].FirstKey + Tracks.Data[i].KeyCount - 1].Frame);
+        return (uint32_t)ceilf(last) + 1;
+    }
+
+    size_t ShapeCount() const { return Shapes.Count; }
+
+private:
+    // An array in the mapped file or in one of the vectors filled by the text parser.
+    template<class T>
+    struct Array
+    {
+        const T *Data;
+        size_t Count;
+        Array() : Data(nullptr), Count(0) {}
+        void View(const std::vector<T> &v) { Data = v.data(); Count = v.size(); }
+    };
+
+    MappedFile File;
+    SceneCameraRecord Camera;
+    Array<Material> Materials;
+    Array<Light> Lights;
+    Array<SceneShapeRecord> Shapes;
+    Array<SceneTrackRecord> Tracks;
+    Array<SceneKeyRecord> Keys;
+    // records of a scene loaded from the text form
+    std::vector<Material> ParsedMaterials;
+    std::vector<Light> ParsedLights;
+    std::vector<SceneShapeRecord> ParsedShapes;
+    std::vector<SceneTrackRecord> ParsedTracks;
+    std::vector<SceneKeyRecord> ParsedKeys;
+    // state of the animation after Build
+    uint32_t Frame;
+    Renderer *Target;
+    std::vector<Shape*> BuiltShapes;
+
+    static SceneCameraRecord DefaultCamera()
+    {
+        SceneCameraRecord camera;
+        camera.Position = Vec3f(0, 0, 0);
+        camera.Direction = Vec3f(0, 0, -1);
+        camera.FieldOfView = (float)(M_PI / 3.);
+        camera.Target = SceneNoTarget;
+        return camera;
+    }
+
+    void Clear()
+    {
+        File.Close();
+        Camera = DefaultCamera();
+        Materials = Array<Material>();
+        Lights = Array<Light>();
+        Shapes = Array<SceneShapeRecord>();
+        Tracks = Array<SceneTrackRecord>();
+        Keys = Array<SceneKeyRecord>();
+        ParsedMaterials.clear();
+        ParsedLights.clear();
+        ParsedShapes.clear();
+        ParsedTracks.clear();
+        ParsedKeys.clear();
+    }
+
+    Shape* MakeShape(const SceneShapeRecord &r) const
+    {
+        const Material &material = Materials.Data[r.Material];
+        const Vec3f direction = Vec3f(r.Direction).Normalize();
+        switch((ShapeType)r.Type)
+        {
+        case ShapeType::Sphere: return new Sphere(r.Center, r.Size[0], material);
+        case ShapeType::Cube: return new Cube(r.Center, r.Size[0], material);
+        case ShapeType::Circle: return new Circle(r.Center, r.Size[0], direction, material);
+        case ShapeType::Plane: return new Plane(r.Center, direction, material);
+        case ShapeType::Rectangle: return new Rectangle(r.Center, r.Size[0], r.Size[1], direction, material);
+        default: return new Ellipse(r.Center, r.Point, r.Size[0], direction, material);
+        }
+    }
+
+    static Vec3f Interpolate(const SceneKeyRecord *keys, const uint32_t count, const float frame)
+    {
+        if(frame <= keys[0].Frame)
+            return keys[0].Value;
+        for(uint32_t i = 1; i < count; ++i)
+            if(frame < keys[i].Frame)
+            {
+                const SceneKeyRecord &a = keys[i - 1], &b = keys[i];
+                const float t = (frame - a.Frame) / (b.Frame - a.Frame);
+                return a.Value + (b.Value - a.Value) * t;
+            }
+        return keys[count - 1].Value;
+    }
+
+    static SceneSection Section(uint64_t &offset, const size_t count, const size_t recordSize)
+    {
+        SceneSection section = { offset, count };
+        offset += (count * recordSize + 7) / 8 * 8;
+        return section;
+    }
+    template<class T>
+    static void WriteSection(OutputSink &output, const Array<T> &array)
+    {
+        output.Write(array.Data, array.Count * sizeof(T));
+        static const char padding[8] = {};
+        output.Write(padding, (8 - array.Count * sizeof(T) % 8) % 8);
+    }
+
+    // Points the arrays to the sections of the mapped binary file after checking, that
+    // they lie in the file and refer to existing records.
+    bool ViewBinary(std::string &error)
+    {
+        const char *data = File.GetData();
+        const size_t size = File.GetSize();
+        SceneFileHeader header;
+        if(size < sizeof(header))
+        {
+            error = "the scene file is truncated";
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        if(header.Version != SceneFileVersion || header.ByteOrder != SceneFileByteOrder)
+        {
+            error = "the scene file was made by another version or on a machine with another byte order";
+            return false;
+        }
+        if(!ViewSection(data, size, header.Materials, Materials) || !ViewSection(data, size, header.Lights, Lights) ||
+            !ViewSection(data, size, header.Shapes, Shapes) || !ViewSection(data, size, header.Tracks, Tracks) ||
+            !ViewSection(data, size, header.Keys, Keys))
+        {
+            error = "a section of the scene file lies outside of it";
+            return false;
+        }
+        Camera = header.Camera;
+        for(size_t i = 0; i < Shapes.Count; ++i)
+            if(Shapes.Data[i].Type > (uint32_t)ShapeType::Ellipse || Shapes.Data[i].Material >= Materials.Count)
+            {
+                error = "shape " + std::to_string(i) + " has an unknown type or material";
+                return false;
+            }
+        return CheckReferences(error);
+    }
+    template<class T>
+    static bool ViewSection(const char *data, const size_t size, const SceneSection &section, Array<T> &array)
+    {
+        if(section.Offset % alignof(T) != 0 || section.Offset > size ||
+            section.Count > (size - section.Offset) / sizeof(T))
+            return false;
+        array.Data = (const T*)(data + section.Offset);
+        array.Count = (size_t)section.Count;
+        return true;
+    }
+    bool CheckReferences(std::string &error) const
+    {
+        if(Camera.Target != SceneNoTarget && Camera.Target >= Shapes.Count)
+        {
+            error = "the camera's target does not exist";
+            return false;
+        }
+        for(size_t i = 0; i < Tracks.Count; ++i)
+        {
+            const SceneTrackRecord &track = Tracks.Data[i];
+            if((track.Target != SceneNoTarget && track.Target >= Shapes.Count) || track.KeyCount == 0 ||
+                track.FirstKey > Keys.Count || track.KeyCount > Keys.Count - track.FirstKey)
+            {
+                error = "track " + std::to_string(i) + " refers to a shape or keys, which do not exist";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Splits a line of the text form into words.
+    struct LineReader
+    {
+        const char *Position, *End;
+        size_t Number;
+
+        // Moves to the next line and returns its words in words. Returns false at the end of
+        // the text.
+        bool NextLine(std::vector<std::string> &words)
+        {
+            if(Position >= End)
+                return false;
+            ++Number;
+            words.clear();
+            const char *lineEnd = (const char*)memchr(Position, '\n', End - Position);
+            if(!lineEnd) lineEnd = End;
+            const char *p = Position;
+            while(p < lineEnd && *p != '#')
+            {
+                while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+                const char *word = p;
+                while(p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r' && *p != '#') ++p;
+                if(p > word)
+                    words.emplace_back(word, p - word);
+            }
+            Position = lineEnd + 1;
+            return true;
+        }
+    };
+
+    static bool ParseFloat(const std::string &word, float &value)
+    {
+        char *end;
+        value = strtof(word.c_str(), &end);
+        return !word.empty() && *end == '\0';
+    }
+    // Parses count numbers starting at words[first].
+    static bool ParseFloats(const std::vector<std::string> &words, const size_t first, const size_t count, float *values)
+    {
+        if(words.size() < first + count)
+            return false;
+        for(size_t i = 0; i < count; ++i)
+            if(!ParseFloat(words[first + i], values[i]))
+                return false;
+        return true;
+    }
+
+    bool ParseText(std::string &error)
+    {
+        LineReader reader = { File.GetData(), File.GetData() + File.GetSize(), 0 };
+        std::unordered_map<std::string, uint32_t> materials, shapes;
+        // keys of every track by its target's name, in the order of the tracks
+        std::vector<std::pair<std::string, std::vector<SceneKeyRecord>>> tracks;
+        std::string cameraTarget;
+        std::vector<std::string> words;
+        while(reader.NextLine(words))
+        {
+            if(words.empty())
+                continue;
+            const std::string &kind = words[0];
+            float v[12];
+            bool valid = true;
+            // position of the material's name for shapes
+            size_t materialWord = 0;
+            SceneShapeRecord shape = SceneShapeRecord();
+            if(kind == "material")
+            {
+                valid = words.size() == 11 && ParseFloats(words, 2, 9, v);
+                if(valid)
+                {
+                    materials[words[1]] = (uint32_t)ParsedMaterials.size();
+                    ParsedMaterials.push_back(Material(v[0], Vec4f(v[1], v[2], v[3], v[4]), Vec3f(v[5], v[6], v[7]), v[8]));
+                }
+            }
+            else if(kind == "light")
+            {
+                valid = words.size() == 5 && ParseFloats(words, 1, 4, v);
+                if(valid)
+                    ParsedLights.push_back(Light(Vec3f(v[0], v[1], v[2]), v[3]));
+            }
+            else if(kind == "camera")
+            {
+                valid = ParseFloats(words, 1, 3, v);
+                if(valid)
+                    Camera.Position = Vec3f(v[0], v[1], v[2]);
+                for(size_t i = 4; valid && i < words.size(); )
+                {
+                    if(words[i] == "direction" && ParseFloats(words, i + 1, 3, v))
+                    {
+                        Camera.Direction = Vec3f(v[0], v[1], v[2]);
+                        i += 4;
+                    }
+                    else if(words[i] == "fov" && ParseFloats(words, i + 1, 1, v))
+                    {
+                        Camera.FieldOfView = v[0] * (float)M_PI / 180.f;
+                        i += 2;
+                    }
+                    else if(words[i] == "target" && i + 1 < words.size())
+                    {
+                        cameraTarget = words[i + 1];
+                        i += 2;
+                    }
+                    else
+                        valid = false;
+                }
+            }
+            else if(kind == "key")
+            {
+                valid = words.size() == 6 && ParseFloats(words, 2, 4, v);
+                if(valid)
+                {
+                    if(tracks.empty() || tracks.back().first != words[1])
+                    {
+                        size_t i = 0;
+                        while(i < tracks.size() && tracks[i].first != words[1]) ++i;
+                        if(i == tracks.size())
+                            tracks.emplace_back(words[1], std::vector<SceneKeyRecord>());
+                        else
+                            std::swap(tracks[i], tracks.back());
+                    }
+                    SceneKeyRecord key = { v[0], Vec3f(v[1], v[2], v[3]) };
+                    tracks.back().second.push_back(key);
+                }
+            }
+            else if(kind == "sphere" || kind == "cube")
+            {
+                valid = ParseFloats(words, 1, 4, v);
+                shape.Type = (uint32_t)(kind == "sphere" ? ShapeType::Sphere : ShapeType::Cube);
+                shape.Center = Vec3f(v[0], v[1], v[2]);
+                shape.Size[0] = v[3];
+                materialWord = 5;
+            }
+            else if(kind == "circle")
+            {
+                valid = ParseFloats(words, 1, 7, v);
+                shape.Type = (uint32_t)ShapeType::Circle;
+                shape.Center = Vec3f(v[0], v[1], v[2]);
+                shape.Size[0] = v[3];
+                shape.Direction = Vec3f(v[4], v[5], v[6]);
+                materialWord = 8;
+            }
+            else if(kind == "plane")
+            {
+                valid = ParseFloats(words, 1, 6, v);
+                shape.Type = (uint32_t)ShapeType::Plane;
+                shape.Center = Vec3f(v[0], v[1], v[2]);
+                shape.Direction = Vec3f(v[3], v[4], v[5]);
+                materialWord = 7;
+            }
+            else if(kind == "rectangle")
+            {
+                valid = ParseFloats(words, 1, 8, v);
+                shape.Type = (uint32_t)ShapeType::Rectangle;
+                shape.Center = Vec3f(v[0], v[1], v[2]);
+                shape.Size[0] = v[3];
+                shape.Size[1] = v[4];
+                shape.Direction = Vec3f(v[5], v[6], v[7]);
+                materialWord = 9;
+            }
+            else if(kind == "ellipse")
+            {
+                valid = ParseFloats(words, 1, 10, v);
+                shape.Type = (uint32_t)ShapeType::Ellipse;
+                shape.Center = Vec3f(v[0], v[1], v[2]);
+                shape.Point = Vec3f(v[3], v[4], v[5]);
+                shape.Size[0] = v[6];
+                shape.Direction = Vec3f(v[7], v[8], v[9]);
+                materialWord = 11;
+            }
+            else
+            {
+                error = "line " + std::to_string(reader.Number) + ": unknown item " + kind;
+                return false;
+            }
+
+            if(valid && materialWord > 0)
+            {
+                valid = words.size() == materialWord + 1 || words.size() == materialWord + 2;
+                if(valid)
+                {
+                    std::unordered_map<std::string, uint32_t>::const_iterator material = materials.find(words[materialWord]);
+                    if(material == materials.end())
+                    {
+                        error = "line " + std::to_string(reader.Number) + ": unknown material " + words[materialWord];
+                        return false;
+                    }
+                    shape.Material = material->second;
+                    if(words.size() == materialWord + 2)
+                        shapes[words[materialWord + 1]] = (uint32_t)ParsedShapes.size();
+                    ParsedShapes.push_back(shape);
+                }
+            }
+            if(!valid)
+            {
+                error = "line " + std::to_string(reader.Number) + ": wrong arguments of " + kind;
+                return false;
+            }
+        }
+
+        if(!cameraTarget.empty())
+        {
+            std::unordered_map<std::string, uint32_t>::const_iterator target = shapes.find(cameraTarget);
+            if(target == shapes.end())
+            {
+                error = "unknown camera target " + cameraTarget;
+                return false;
+            }
+            Camera.Target = target->second;
+        }
+        for(size_t i = 0; i < tracks.size(); ++i)
+        {
+            SceneTrackRecord track = { SceneNoTarget, (uint32_t)ParsedKeys.size(), (uint32_t)tracks[i].second.size() };
+            if(tracks[i].first != "camera")
+            {
+                std::unordered_map<std::string, uint32_t>::const_iterator target = shapes.find(tracks[i].first);
+                if(target == shapes.end())
+                {
+                    error = "keys of unknown shape " + tracks[i].first;
+                    return false;
+                }
+                track.Target = target->second;
+            }
+            std::stable_sort(tracks[i].second.begin(), tracks[i].second.end(),
+                [](const SceneKeyRecord &a, const SceneKeyRecord &b) { return a.Frame < b.Frame; });
+            ParsedKeys.insert(ParsedKeys.end(), tracks[i].second.begin(), tracks[i].second.end());
+            ParsedTracks.push_back(track);
+        }
+
+        Materials.View(ParsedMaterials);
+        Lights.View(ParsedLights);
+        Shapes.View(ParsedShapes);
+        Tracks.View(ParsedTracks);
+        Keys.View(ParsedKeys);
+        return CheckReferences(error);
+    }
+};
+#endif // SCENEFILE_CPP
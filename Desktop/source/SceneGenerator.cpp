@@ -0,0 +1,142 @@
+#ifndef SCENEGENERATOR_CPP
+#define SCENEGENERATOR_CPP
+
+#include <cmath>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include "../include/Vector.hpp"
+#include "Shapes.cpp"
+#include "Renderer.cpp"
+
+// Kinds of generated scenes. All of them stand on a floor in the box x in [-10, 10],
+// y in [-5, 5], z in [-45, -5] in front of the camera, which is left where it is.
+// - Spheres: a field of spheres, which are smaller, the more of them there are.
+// - Rectangles: a grid of tilted rectangles in layers one behind another.
+// - Ellipses: a cloud of ellipses facing random directions.
+// - Lights: many lights above a few spheres; the count is the number of lights.
+enum class GeneratedScene { Spheres, Rectangles, Ellipses, Lights };
+
+// Makes large scenes for stress and scaling tests. The same kind, count and seed always
+// give the same scene on every platform, because the random numbers are made here instead
+// of by rand or the standard library's distributions.
+class SceneGenerator
+{
+public:
+    SceneGenerator(const uint32_t seed = 1) : State(seed) {}
+
+    // Reads "spheres", "rectangles", "ellipses" or "lights".
+    static bool ParseKind(const std::string &name, GeneratedScene &kind)
+    {
+        const char *names[] = { "spheres", "rectangles", "ellipses", "lights" };
+        for(int i = 0; i < 4; ++i)
+            if(name == names[i])
+            {
+                kind = (GeneratedScene)i;
+                return true;
+            }
+        return false;
+    }
+
+    // Adds the shapes and the lights of the scene to the renderer, which deletes them.
+    void Generate(Renderer &renderer, const GeneratedScene kind, const uint32_t count)
+    {
+        // the same materials as in the demo scene, so every kind has reflections and refractions
+        const Material materials[] =
+        {
+            Material(1.0, Vec4f(0.6,  0.3, 0.1, 0.0), Vec3f(0.4, 0.4, 0.3),   50.),
+            Material(1.5, Vec4f(0.0,  0.5, 0.1, 0.8), Vec3f(0.6, 0.7, 0.8),  125.),
+            Material(1.0, Vec4f(0.9,  0.1, 0.0, 0.0), Vec3f(0.3, 0.1, 0.1),   10.),
+            Material(1.0, Vec4f(0.0, 10.0, 0.8, 0.0), Vec3f(1.0, 1.0, 1.0), 1425.)
+        };
+        renderer.Shapes.push_back(new Plane(Vec3f(0, -6, 0), Vec3f(0, 1, 0), materials[2]));
+        renderer.Shapes.reserve(renderer.Shapes.size() + (kind == GeneratedScene::Lights ? 64 : count));
+
+        // side of the cube of space, which every shape gets
+        const float cell = cbrtf(20.f * 10.f * 40.f / (float)std::max(count, 1u));
+        switch(kind)
+        {
+        case GeneratedScene::Spheres:
+            for(uint32_t i = 0; i < count; ++i)
+            {
+                const Vec3f center = RandomPoint();
+                const float radius = cell * Uniform(0.2f, 0.45f);
+                renderer.Shapes.push_back(new Sphere(center, radius, materials[Next() % 4]));
+            }
+            break;
+        case GeneratedScene::Rectangles:
+        {
+            // columns x rows rectangles in every layer
+            const uint32_t columns = std::max(1u, (uint32_t)(20.f / cell)), rows = std::max(1u, (uint32_t)(10.f / cell));
+            for(uint32_t i = 0; i < count; ++i)
+            {
+                const uint32_t column = i % columns, row = i / columns % rows, layer = i / columns / rows;
+                const Vec3f center(-10.f + (column + 0.5f) * cell, -5.f + (row + 0.5f) * cell, -5.f - (layer + 0.5f) * cell);
+                const float tiltX = Uniform(-0.5f, 0.5f), tiltY = Uniform(-0.5f, 0.5f);
+                const float width = cell * Uniform(0.3f, 0.8f), height = cell * Uniform(0.3f, 0.8f);
+                renderer.Shapes.push_back(new Rectangle(center, width, height, Vec3f(tiltX, tiltY, 1).Normalize(),
+                    materials[Next() % 4]));
+            }
+            break;
+        }
+        case GeneratedScene::Ellipses:
+            for(uint32_t i = 0; i < count; ++i)
+            {
+                const Vec3f focus = RandomPoint(), offset = RandomDirection() * (cell * 0.3f),
+                    facing = RandomDirection();
+                renderer.Shapes.push_back(new Ellipse(focus - offset, focus + offset, cell * 0.2f,
+                    facing, materials[Next() % 4]));
+            }
+            break;
+        case GeneratedScene::Lights:
+            for(uint32_t i = 0; i < 64; ++i)
+                renderer.Shapes.push_back(new Sphere(Vec3f(-7.f + (i % 8) * 2.f, -5.f, -8.f - (i / 8) * 2.f), 0.9f,
+                    materials[i % 4]));
+            // the total intensity of all lights is 5, like the demo scene's
+            for(uint32_t i = 0; i < count; ++i)
+            {
+                const float x = Uniform(-15, 15), y = Uniform(8, 20), z = Uniform(-40, 0);
+                renderer.Lights.push_back(new Light(Vec3f(x, y, z), 5.f / count));
+            }
+            return;
+        }
+        renderer.Lights.push_back(new Light(Vec3f(-5, 10, -1), 1.5));
+        renderer.Lights.push_back(new Light(Vec3f(5, 10, -1), 1.8));
+        renderer.Lights.push_back(new Light(Vec3f(5, 20, -1), 1.7));
+    }
+
+private:
+    uint64_t State;
+
+    // SplitMix64
+    uint32_t Next()
+    {
+        uint64_t z = (State += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return (uint32_t)((z ^ (z >> 31)) >> 32);
+    }
+    float Uniform(const float minimum, const float maximum)
+    {
+        return minimum + (maximum - minimum) * (float)((Next() >> 8) * (1.0 / 16777216.0));
+    }
+    // The calls are separate statements, because the order of evaluating arguments is
+    // unspecified, which would make the scenes depend on the compiler.
+    Vec3f RandomPoint()
+    {
+        const float x = Uniform(-10, 10), y = Uniform(-5, 5), z = Uniform(-45, -5);
+        return Vec3f(x, y, z);
+    }
+    Vec3f RandomDirection()
+    {
+        for(;;)
+        {
+            const float x = Uniform(-1, 1), y = Uniform(-1, 1), z = Uniform(-1, 1);
+            Vec3f v(x, y, z);
+            const float norm = v.Norm();
+            if(norm > 0.01f && norm <= 1.f)
+                return v * (1.f / norm);
+        }
+    }
+};
+#endif // SCENEGENERATOR_CPP
@@ -3,6 +3,8 @@
 
 #include "../include/Vector.hpp"
 #include <cmath>
+#include <algorithm>
+#include <float.h>
 
 struct Light
 {
@@ -24,13 +26,84 @@ struct Material
     Material() : RefractiveIndex(1), Albedo(1,0,0,0), DiffuseColor(), SpecularExponent() {}
 };
 
+// An axis-aligned box used to bound shapes in the acceleration structure.
+struct BoundingBox
+{
+    Vec3f Min, Max;
+
+    // An empty box, which becomes a point after it is extended by the first point.
+    BoundingBox() : Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+    BoundingBox(const Vec3f &min, const Vec3f &max) : Min(min), Max(max) {}
+
+    void Extend(const Vec3f &point)
+    {
+        Min = Vec3f(std::min(Min.X, point.X), std::min(Min.Y, point.Y), std::min(Min.Z, point.Z));
+        Max = Vec3f(std::max(Max.X, point.X), std::max(Max.Y, point.Y), std::max(Max.Z, point.Z));
+    }
+    void Extend(const BoundingBox &box)
+    {
+        Extend(box.Min);
+        Extend(box.Max);
+    }
+    Vec3f Centroid() const { return (Min + Max) * 0.5f; }
+    float SurfaceArea() const
+    {
+        const Vec3f d = Max - Min;
+        if(d.X < 0 || d.Y < 0 || d.Z < 0) return 0; // empty box
+        return 2.f * (d.X*d.Y + d.Y*d.Z + d.Z*d.X);
+    }
+    // Slab test. inverseDirection holds the reciprocals of the ray direction's components.
+    bool RayIntersect(const Vec3f &origin, const Vec3f &inverseDirection, const float maxDistance,
+        float &entryDistance) const
+    {
+        float tx1 = (Min.X - origin.X) * inverseDirection.X, tx2 = (Max.X - origin.X) * inverseDirection.X;
+        float tNear = std::min(tx1, tx2), tFar = std::max(tx1, tx2);
+        float ty1 = (Min.Y - origin.Y) * inverseDirection.Y, ty2 = (Max.Y - origin.Y) * inverseDirection.Y;
+        tNear = std::max(tNear, std::min(ty1, ty2));
+        tFar = std::min(tFar, std::max(ty1, ty2));
+        float tz1 = (Min.Z - origin.Z) * inverseDirection.Z, tz2 = (Max.Z - origin.Z) * inverseDirection.Z;
+        tNear = std::max(tNear, std::min(tz1, tz2));
+        tFar = std::min(tFar, std::max(tz1, tz2));
+        entryDistance = tNear;
+        return tFar >= std::max(tNear, 0.f) && tNear <= maxDistance;
+    }
+};
+
+// Half extents of the box bounding a disc of the given radius lying in the plane
+// perpendicular to normal.
+inline Vec3f DiscHalfExtents(const Vec3f &normal, const float radius)
+{
+    const float n2 = normal*normal;
+    return Vec3f(radius * sqrtf(std::max(0.f, 1.f - normal.X*normal.X / n2)),
+                 radius * sqrtf(std::max(0.f, 1.f - normal.Y*normal.Y / n2)),
+                 radius * sqrtf(std::max(0.f, 1.f - normal.Z*normal.Z / n2)));
+}
+
+enum class ShapeType : byte { Sphere, Cube, Circle, Plane, Rectangle, Ellipse };
+
 struct Shape
 {
     Vec3f Center;
     Material Surface;
     Shape(const Vec3f &center, const Material &material) : Center(center), Surface(material) {}
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, Vec3f &hitPoint, Vec3f &normal)
-        const = 0;
+    virtual ~Shape() {}
+    virtual ShapeType Type() const = 0;
+    // Returns true, if the ray hits the shape at a distance in (minDistance, maxDistance).
+    // Only the distance is computed, so the closest hit can be searched for without
+    // computing hit points and normals of the shapes, which are hit farther.
+    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, float &distance) const = 0;
+    // Normal vector at hitPoint, which was found by RayIntersect for the same ray. It points
+    // to the side of the surface, from which the ray came.
+    virtual Vec3f Normal(const Vec3f &origin, const Vec3f &direction, const Vec3f &hitPoint) const = 0;
+    // Returns true, if the ray hits the shape closer than maxDistance.
+    bool Occludes(const Vec3f &origin, const Vec3f &direction, const float maxDistance) const
+    {
+        float distance;
+        return RayIntersect(origin, direction, 0.f, maxDistance, distance);
+    }
+    // Returns false for unbounded shapes, which cannot be put in the acceleration structure.
+    virtual bool GetBounds(BoundingBox &) const { return false; }
 };
 
 struct Sphere : public Shape
@@ -40,37 +113,40 @@ struct Sphere : public Shape
     Sphere(const Vec3f &center, const float radius, const Material &material)
         : Shape(center, material), Radius(radius) {}
 
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, 
-        Vec3f &hitPoint, Vec3f &normal) const override
+    virtual ShapeType Type() const override { return ShapeType::Sphere; }
+
+    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, float &distance) const override
     {
         Vec3f L = Center - origin;
         float tca = L*direction;
+        // both intersections lie in [tca - Radius, tca + Radius]
+        if(tca - Radius >= maxDistance || tca + Radius <= minDistance) return false;
         float d2 = L*L - tca*tca;
         if (d2 > Radius*Radius) return false;
         float thc = sqrtf(Radius*Radius - d2);
         distance = tca - thc;// thc jest zawsze nieujemne, więc tca - thc jest zawsze mniejsze od tca + thc
-        if(distance > 0)
-        {
-            hitPoint = origin + distance * direction;
-            // if(L.Norm() >= Radius)
-            if(L*L >= Radius*Radius)
-                normal = (hitPoint - Center).Normalize();
-            else
-                normal = (Center - hitPoint).Normalize();
-            return true;
-        }
+        if(distance > minDistance)
+            return distance < maxDistance;
         distance = tca + thc;
-        if(distance > 0)
-        {
-            hitPoint = origin + distance * direction;
-            // if(L.Norm() >= Radius)
-            if(L*L >= Radius*Radius)
-                normal = (hitPoint - Center).Normalize();
-            else
-                normal = (Center - hitPoint).Normalize();
-            return true;
-        }
-        return false;
+        return distance > minDistance && distance < maxDistance;
+    }
+
+    virtual Vec3f Normal(const Vec3f &origin, const Vec3f &, const Vec3f &hitPoint) const override
+    {
+        const Vec3f L = Center - origin;
+        // if(L.Norm() >= Radius)
+        if(L*L >= Radius*Radius)
+            return (hitPoint - Center).Normalize();
+        else // the ray comes from the inside of the sphere
+            return (Center - hitPoint).Normalize();
+    }
+
+    virtual bool GetBounds(BoundingBox &box) const override
+    {
+        const Vec3f r(Radius, Radius, Radius);
+        box = BoundingBox(Center - r, Center + r);
+        return true;
     }
 };
 
@@ -80,12 +156,25 @@ struct Cube : public Shape
 
     Cube(const Vec3f &center, const float edge, const Material &material)
         : Shape(center, material), Edge(edge) {}
-    
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, 
-        Vec3f &hitPoint, Vec3f &normal) const override
+
+    virtual ShapeType Type() const override { return ShapeType::Cube; }
+
+    virtual bool RayIntersect(const Vec3f &, const Vec3f &, const float, const float, float &) const override
     {
         return false;
     }
+
+    virtual Vec3f Normal(const Vec3f &, const Vec3f &direction, const Vec3f &) const override
+    {
+        return -direction;
+    }
+
+    virtual bool GetBounds(BoundingBox &box) const override
+    {
+        const Vec3f h(Edge / 2.f, Edge / 2.f, Edge / 2.f);
+        box = BoundingBox(Center - h, Center + h);
+        return true;
+    }
 };
 
 struct PlainShape : public Shape
@@ -96,6 +185,15 @@ public:
     PlainShape(const Vec3f &center, const Vec3f &normal, const Material &material)
         : Shape(center, material), Direction(normal) {}
     virtual void SetDirection(const Vec3f &direction) { Direction = direction; }
+    const Vec3f& GetDirection() const { return Direction; }
+
+    virtual Vec3f Normal(const Vec3f &, const Vec3f &direction, const Vec3f &) const override
+    {
+        if(Direction*direction < 0) // the ray comes from the side of the shape that is pointed by its Direction vector
+            return Direction;
+        else // the ray comes from the other side of the shape
+            return -Direction;
+    }
 };
 
 struct Circle : public PlainShape
@@ -106,25 +204,25 @@ struct Circle : public PlainShape
     const Material &material)
         : PlainShape(center, direction, material), Radius(radius) {}
 
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, 
-        Vec3f &hitPoint, Vec3f &normal) const override
+    virtual ShapeType Type() const override { return ShapeType::Circle; }
+
+    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, float &distance) const override
     {
         const float cosDd = Direction*direction;
         if(cosDd == 0) return false; // the ray does not hit the circle, because they are parallel
         distance = ( Direction*(Center - origin) ) / cosDd;
-        if(distance <= 0) return false;
-        hitPoint = origin + distance * direction;
+        if(distance <= minDistance || distance >= maxDistance) return false;
         // (hitPoint - Center).Norm() <= Radius
-        const Vec3f fromCenterToP = hitPoint - Center;
-        if(fromCenterToP*fromCenterToP <= Radius*Radius)
-        {
-            if(cosDd < 0) // the ray comes from the side of the circle that is pointed by its Direction vector
-                normal = Direction;
-            else // the ray comes from the other side of the circle
-                normal = -Direction;
-            return true;
-        }
-        return false;
+        const Vec3f fromCenterToP = origin + distance * direction - Center;
+        return fromCenterToP*fromCenterToP <= Radius*Radius;
+    }
+
+    virtual bool GetBounds(BoundingBox &box) const override
+    {
+        const Vec3f h = DiscHalfExtents(Direction, Radius);
+        box = BoundingBox(Center - h, Center + h);
+        return true;
     }
 };
 
@@ -133,22 +231,15 @@ struct Plane : public PlainShape
     Plane(const Vec3f &center, const Vec3f &direction, const Material &material)
         : PlainShape(center, direction, material) {}
 
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, 
-        Vec3f &hitPoint, Vec3f &normal) const override
+    virtual ShapeType Type() const override { return ShapeType::Plane; }
+
+    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, float &distance) const override
     {
         const float cosDd = Direction*direction;
         if(cosDd == 0) return false; // the ray does not hit the plane, because they are parallel
         distance = ( Direction*(Center - origin) ) / cosDd;
-        if(distance > 0)
-        {
-            hitPoint = origin + distance * direction;
-            if(cosDd < 0) // the ray comes from the side of the plane that is pointed by its Direction vector
-                normal = Direction;
-            else // the ray comes from the other side of the plane
-                normal = -Direction;
-            return true;
-        }
-        return false;
+        return distance > minDistance && distance < maxDistance;
     }
 };
 
@@ -161,14 +252,18 @@ struct Rectangle : public PlainShape
         : PlainShape(center, direction, material), Width(width), Height(height)
     { RotateAxes(); }
 
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, 
-        Vec3f &hitPoint, Vec3f &normal) const override
+    virtual ShapeType Type() const override { return ShapeType::Rectangle; }
+    const Vec3f& GetHorizontalAxis() const { return HorizontalAxis; }
+    const Vec3f& GetVerticalAxis() const { return VerticalAxis; }
+
+    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, float &distance) const override
     {
         const float cosDd = Direction*direction;
         if(cosDd == 0) return false; // the ray does not hit the rectangle, because they are parallel
         distance = ( Direction*(Center - origin) ) / cosDd;
-        if(distance <= 0) return false;
-        hitPoint = origin + distance * direction;
+        if(distance <= minDistance || distance >= maxDistance) return false;
+        const Vec3f hitPoint = origin + distance * direction;
 
         /* return true if:
         1) projection of fromCenterToP = hitPoint - Center onto 'HorizontalAxis' has norm less than 'Width' / 2 and
@@ -191,16 +286,18 @@ struct Rectangle : public PlainShape
         - equal to 0 if the p point is equal to the Center point */
         const float horizontalLength = fromCenterToP * HorizontalAxis,
                     verticalLength = fromCenterToP * VerticalAxis;
-        if(horizontalLength <= Width / 2.f && horizontalLength >= -Width / 2.f &&
-            verticalLength <= Height / 2.f && verticalLength >= -Height / 2.f)
-        {
-            if(cosDd < 0) // the ray comes from the side of the rectangle that is pointed by its Direction vector
-                normal = Direction;
-            else // the ray comes from the other side of the rectangle
-                normal = -Direction;
-            return true;
-        }
-        return false;
+        return horizontalLength <= Width / 2.f && horizontalLength >= -Width / 2.f &&
+            verticalLength <= Height / 2.f && verticalLength >= -Height / 2.f;
+    }
+
+    virtual bool GetBounds(BoundingBox &box) const override
+    {
+        const Vec3f h(
+            fabsf(HorizontalAxis.X) * Width / 2.f + fabsf(VerticalAxis.X) * Height / 2.f,
+            fabsf(HorizontalAxis.Y) * Width / 2.f + fabsf(VerticalAxis.Y) * Height / 2.f,
+            fabsf(HorizontalAxis.Z) * Width / 2.f + fabsf(VerticalAxis.Z) * Height / 2.f);
+        box = BoundingBox(Center - h, Center + h);
+        return true;
     }
 
     virtual void SetDirection(const Vec3f &direction)
@@ -304,23 +401,30 @@ struct Ellipse : public PlainShape
         : PlainShape(center1, direction, material), Focus2(center2),
         FocusDistanceSum((center1 - center2).Norm() + additionalFocusesDistance) {}
 
-    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, float &distance, 
-        Vec3f &hitPoint, Vec3f &normal) const override
+    virtual ShapeType Type() const override { return ShapeType::Ellipse; }
+
+    virtual bool RayIntersect(const Vec3f &origin, const Vec3f &direction, const float minDistance,
+        const float maxDistance, float &distance) const override
     {
         const float cosDd = Direction*direction;
         if(cosDd == 0) return false; // the ray does not hit the ellipse, because they are parallel
         distance = ( Direction*(Center - origin) ) / cosDd;
-        if(distance <= 0) return false;
-        hitPoint = origin + distance * direction;
-        if((hitPoint - Center).Norm() + (hitPoint - Focus2).Norm() <= FocusDistanceSum)
-        {
-            if(cosDd < 0) // the ray comes from the side of the ellipse that is pointed by its Direction vector
-                normal = Direction;
-            else // the ray comes from the other side of the ellipse
-                normal = -Direction;
-            return true;
-        }
-        return false;
+        if(distance <= minDistance || distance >= maxDistance) return false;
+        const Vec3f hitPoint = origin + distance * direction;
+        return (hitPoint - Center).Norm() + (hitPoint - Focus2).Norm() <= FocusDistanceSum;
+    }
+
+    virtual bool GetBounds(BoundingBox &box) const override
+    {
+        // Every point of the ellipse lies inside the sphere around the midpoint between the
+        // focuses, whose radius is the semi-major axis. Focus2 does not have to lie on the
+        // ellipse's plane, so the bound is the disc cut from that sphere by the plane.
+        const Vec3f normal = Vec3f(Direction).Normalize(), middle = (Center + Focus2) * 0.5f;
+        const float semiMajorAxis = FocusDistanceSum / 2.f, planeDistance = (middle - Center) * normal;
+        const Vec3f discCenter = middle - normal * planeDistance,
+            h = DiscHalfExtents(normal, sqrtf(std::max(0.f, semiMajorAxis*semiMajorAxis - planeDistance*planeDistance)));
+        box = BoundingBox(discCenter - h, discCenter + h);
+        return true;
     }
 };
 #endif // SHAPES_CPP
\ No newline at end of file
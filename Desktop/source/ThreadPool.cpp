@@ -0,0 +1,110 @@
+#ifndef THREADPOOL_CPP
+#define THREADPOOL_CPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "../include/Vector.hpp"
+
+// A fixed set of worker threads, which are created once and woken up for every job.
+// The thread calling Run takes part in the job as the thread with index 0, so a pool
+// of N threads owns only N - 1 std::threads.
+class ThreadPool
+{
+public:
+    const byte TotalThreads;
+
+    ThreadPool(const byte numberOfThreads)
+        : TotalThreads(numberOfThreads > 0 ? numberOfThreads : 1),
+          JobCall(nullptr), JobObject(nullptr), Generation(0), PendingWorkers(0), Stopping(false)
+    {
+        for(byte i = 1; i < TotalThreads; ++i)
+            Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Stopping = true;
+        }
+        WakeCondition.notify_all();
+        for(size_t i = 0; i < Workers.size(); ++i)
+            Workers[i].join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls job(threadIndex) once on every thread of the pool, including the calling one,
+    // and returns after all of them have finished. The calling thread sleeps instead of
+    // spinning while it waits for the workers. job is called through a plain function
+    // pointer, so unlike std::function, passing a lambda never allocates memory.
+    template<class Job>
+    void Run(const Job &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            JobCall = &CallJob<Job>;
+            JobObject = &job;
+            PendingWorkers = TotalThreads - 1;
+            ++Generation;
+        }
+        WakeCondition.notify_all();
+
+        job(0);
+
+        std::unique_lock<std::mutex> lock(Mutex);
+        DoneCondition.wait(lock, [this] { return PendingWorkers == 0; });
+        JobCall = nullptr;
+        JobObject = nullptr;
+    }
+
+private:
+    typedef void (*JobFunction)(const void*, byte);
+    std::vector<std::thread> Workers;
+    std::mutex Mutex;
+    // Signalled when a new job is published or the pool is being destroyed.
+    std::condition_variable WakeCondition;
+    // Signalled by the last worker, which finishes the current job.
+    std::condition_variable DoneCondition;
+    // The current job is JobCall(JobObject, threadIndex).
+    JobFunction JobCall;
+    const void *JobObject;
+    // Incremented for every job, so a worker can tell a new job from a spurious wake-up.
+    unsigned long long Generation;
+    byte PendingWorkers;
+    bool Stopping;
+
+    template<class Job>
+    static void CallJob(const void *job, const byte threadIndex)
+    {
+        (*(const Job*)job)(threadIndex);
+    }
+
+    void WorkerLoop(const byte threadIndex)
+    {
+        unsigned long long seenGeneration = 0;
+        for(;;)
+        {
+            JobFunction call;
+            const void *job;
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                WakeCondition.wait(lock, [this, seenGeneration]
+                    { return Stopping || Generation != seenGeneration; });
+                if(Stopping)
+                    return;
+                seenGeneration = Generation;
+                call = JobCall;
+                job = JobObject;
+            }
+
+            call(job, threadIndex);
+
+            std::lock_guard<std::mutex> lock(Mutex);
+            if(--PendingWorkers == 0)
+                DoneCondition.notify_one();
+        }
+    }
+};
+#endif // THREADPOOL_CPP
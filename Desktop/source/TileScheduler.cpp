@@ -0,0 +1,103 @@
+#ifndef TILESCHEDULER_CPP
+#define TILESCHEDULER_CPP
+
+#include <vector>
+#include <mutex>
+#include "../include/Vector.hpp"
+
+// A rectangle of pixels [Left, Right) x [Top, Bottom) counted from the top-left corner
+// of the frame.
+struct Tile
+{
+    int Left, Top, Right, Bottom;
+};
+
+// Hands out the tiles of a frame to the threads of a pool. Every thread owns a deque
+// of tiles, which it takes from the front. A thread, whose deque is empty, steals from
+// the back of the other threads' deques, so all threads stay busy until the last tile
+// of the frame is taken.
+class TileScheduler
+{
+public:
+    TileScheduler(const byte numberOfThreads)
+        : Queues(numberOfThreads > 0 ? numberOfThreads : 1) {}
+
+    // Cuts the frame into tileWidth x tileHeight tiles and deals out contiguous runs of
+    // them to the threads. Tiles on the right and bottom edges are cut short, if the
+    // frame's dimensions are not multiples of the tile's dimensions.
+    // Must not be called while any thread is taking tiles.
+    void Reset(const int frameWidth, const int frameHeight, int tileWidth, int tileHeight)
+    {
+        Reset(frameWidth, 0, frameHeight, tileWidth, tileHeight);
+    }
+    // Same as above, but only for rows [top, bottom) of the frame.
+    void Reset(const int frameWidth, const int top, const int bottom, int tileWidth, int tileHeight)
+    {
+        if(tileWidth < 1) tileWidth = 1;
+        if(tileHeight < 1) tileHeight = 1;
+        const int columns = (frameWidth + tileWidth - 1) / tileWidth,
+                  rows = (bottom - top + tileHeight - 1) / tileHeight;
+        const size_t totalTiles = (size_t)columns * rows, totalQueues = Queues.size();
+        size_t t = 0;
+        for(size_t q = 0; q < totalQueues; ++q)
+        {
+            TileQueue &queue = Queues[q];
+            queue.Tiles.clear();
+            const size_t end = totalTiles * (q + 1) / totalQueues;
+            for( ; t < end; ++t)
+            {
+                Tile tile;
+                tile.Left = (int)(t % columns) * tileWidth;
+                tile.Top = top + (int)(t / columns) * tileHeight;
+                tile.Right = std::min(tile.Left + tileWidth, frameWidth);
+                tile.Bottom = std::min(tile.Top + tileHeight, bottom);
+                queue.Tiles.push_back(tile);
+            }
+            queue.Head = 0;
+            queue.Tail = queue.Tiles.size();
+        }
+    }
+
+    // Returns false, if there are no tiles left in the whole frame.
+    bool Next(const byte threadIndex, Tile &tile)
+    {
+        if(TakeFront(Queues[threadIndex], tile))
+            return true;
+        const size_t totalQueues = Queues.size();
+        for(size_t i = 1; i < totalQueues; ++i)
+            if(StealBack(Queues[(threadIndex + i) % totalQueues], tile))
+                return true;
+        return false;
+    }
+
+private:
+    // Aligned to a cache line, so threads locking their own queues do not contend
+    // for the same line.
+    struct alignas(64) TileQueue
+    {
+        std::mutex Mutex;
+        // Tiles in [Head, Tail) are still to be rendered. The storage is kept between
+        // frames, so dealing out tiles does not allocate after the first frame.
+        std::vector<Tile> Tiles;
+        size_t Head = 0, Tail = 0;
+    };
+    std::vector<TileQueue> Queues;
+
+    static bool TakeFront(TileQueue &queue, Tile &tile)
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if(queue.Head == queue.Tail)
+            return false;
+        tile = queue.Tiles[queue.Head++];
+        return true;
+    }
+    static bool StealBack(TileQueue &queue, Tile &tile)
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if(queue.Head == queue.Tail)
+            return false;
+        tile = queue.Tiles[--queue.Tail];
+        return true;
+    }
+};
+#endif // TILESCHEDULER_CPP
@@ -0,0 +1,178 @@
+#ifndef TIMINGREPORT_CPP
+#define TIMINGREPORT_CPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../include/Vector.hpp"
+#include "../include/OutputSink.hpp"
+#include "Renderer.cpp"
+
+// Timing of a run of the program for job schedulers, as JSON or CSV. Times are in seconds.
+// Every frame's wall time is the time of rendering it. The run's wall time also includes
+// saving the frames, which is mostly done while the next frames are rendered. Rays per second
+// count all rays, if they are counted (see RayCounters), otherwise only the primary rays.
+class TimingReport
+{
+public:
+    struct Frame
+    {
+        uint32_t Number;
+        double WallSeconds;
+        // rays and intersection tests of all threads
+        RayCounters Counters;
+        // time spent rendering by every thread of the renderer
+        std::vector<double> BusySeconds;
+    };
+
+    std::string Scene;
+    uint32_t Width = 0, Height = 0;
+    double WallSeconds = 0;
+    std::vector<Frame> Frames;
+
+    // Adds a frame rendered in wallSeconds, whose work is taken from the renderer's
+    // statistics, which are reset.
+    void AddFrame(const uint32_t number, const double wallSeconds, Renderer &renderer)
+    {
+        Frame frame = { number, wallSeconds, renderer.GetCounters(), std::vector<double>(renderer.TotalThreads) };
+        for(byte t = 0; t < renderer.TotalThreads; ++t)
+            frame.BusySeconds[t] = renderer.GetThreadStatistics(t).BusyNanoseconds * 1e-9;
+        renderer.ResetStatistics();
+        Frames.push_back(frame);
+    }
+
+    // Writes the report to a file, or to the standard output, if path is "-". Files ending
+    // with ".csv" get CSV, other files get JSON. Returns false, if the file could not be
+    // written.
+    bool Write(const std::string &path) const
+    {
+        std::unique_ptr<OutputSink> output = OpenOutputSink(path.c_str());
+        if(!output)
+            return false;
+        const bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        if(csv)
+            WriteCSV(*output);
+        else
+            WriteJSON(*output);
+        return output->Close();
+    }
+
+    // {"scene": ..., "width": ..., "height": ..., "threads": ..., "frames": ..., "wall_seconds": ...,
+    //  "render_seconds": ..., "primary_rays": ..., "rays_per_second": ..., "thread_busy_seconds": [...],
+    //  "frame_timings": [{"frame": ..., "wall_seconds": ..., "primary_rays": ..., "rays_per_second": ...,
+    //  "thread_busy_seconds": [...]}, ...]}
+    // With counted rays, "primary_rays" is followed by "reflection_rays", "refraction_rays",
+    // "shadow_rays", "blocked_shadow_rays" and "intersection_tests": {"sphere": ..., ...}.
+    void WriteJSON(OutputSink &output) const
+    {
+        const Frame total = Total();
+        Print(output, "{\"scene\": \"");
+        for(size_t i = 0; i < Scene.size(); ++i)
+        {
+            const char c = Scene[i];
+            if(c == '"' || c == '\\')
+                output.Put('\\');
+            if((unsigned char)c >= 0x20)
+                output.Put((byte)c);
+        }
+        Print(output, "\", \"width\": %u, \"height\": %u, \"threads\": %u, \"frames\": %u, \"wall_seconds\": %.6f,\n",
+            Width, Height, (unsigned)total.BusySeconds.size(), (unsigned)Frames.size(), WallSeconds);
+        Print(output, " \"render_seconds\": %.6f, ", total.WallSeconds);
+        WriteJSONWork(output, total);
+        Print(output, ",\n \"frame_timings\": [");
+        for(size_t i = 0; i < Frames.size(); ++i)
+        {
+            Print(output, "%s\n  {\"frame\": %u, \"wall_seconds\": %.6f, ", i ? "," : "",
+                Frames[i].Number, Frames[i].WallSeconds);
+            WriteJSONWork(output, Frames[i]);
+            output.Put('}');
+        }
+        Print(output, "\n ]\n}\n");
+    }
+
+    // One line for every frame and the total on the last line, whose frame is "total".
+    // frame,wall_seconds,primary_rays,rays_per_second,thread0_busy_seconds,...
+    // With counted rays, the other rays and the tests of every shape type follow primary_rays.
+    void WriteCSV(OutputSink &output) const
+    {
+        const Frame total = Total();
+        Print(output, "frame,wall_seconds,primary_rays");
+        if(RayCounters::Enabled())
+        {
+            Print(output, ",reflection_rays,refraction_rays,shadow_rays,blocked_shadow_rays");
+            for(int type = 0; type < RayCounters::ShapeTypes; ++type)
+                Print(output, ",%s_tests", RayCounters::ShapeTypeName(type));
+        }
+        Print(output, ",rays_per_second");
+        for(size_t t = 0; t < total.BusySeconds.size(); ++t)
+            Print(output, ",thread%u_busy_seconds", (unsigned)t);
+        output.Put('\n');
+        for(size_t i = 0; i < Frames.size(); ++i)
+        {
+            Print(output, "%u", Frames[i].Number);
+            WriteCSVWork(output, Frames[i]);
+        }
+        Print(output, "total");
+        WriteCSVWork(output, total);
+    }
+
+    // Sum of all frames.
+    Frame Total() const
+    {
+        Frame total = { 0, 0, RayCounters(), std::vector<double>(Frames.empty() ? 0 : Frames[0].BusySeconds.size()) };
+        for(size_t i = 0; i < Frames.size(); ++i)
+        {
+            total.WallSeconds += Frames[i].WallSeconds;
+            total.Counters.Add(Frames[i].Counters);
+            for(size_t t = 0; t < total.BusySeconds.size(); ++t)
+                total.BusySeconds[t] += Frames[i].BusySeconds[t];
+        }
+        return total;
+    }
+
+private:
+    static double RaysPerSecond(const Frame &frame)
+    {
+        return frame.WallSeconds > 0 ? frame.Counters.Rays() / frame.WallSeconds : 0;
+    }
+
+    static void WriteJSONWork(OutputSink &output, const Frame &frame)
+    {
+        const RayCounters &c = frame.Counters;
+        Print(output, "\"primary_rays\": %llu, ", (unsigned long long)c.PrimaryRays);
+        if(RayCounters::Enabled())
+        {
+            Print(output, "\"reflection_rays\": %llu, \"refraction_rays\": %llu, \"shadow_rays\": %llu, "
+                "\"blocked_shadow_rays\": %llu, \"intersection_tests\": {", (unsigned long long)c.ReflectionRays,
+                (unsigned long long)c.RefractionRays, (unsigned long long)c.ShadowRays,
+                (unsigned long long)c.BlockedShadowRays);
+            for(int type = 0; type < RayCounters::ShapeTypes; ++type)
+                Print(output, "%s\"%s\": %llu", type ? ", " : "", RayCounters::ShapeTypeName(type),
+                    (unsigned long long)c.IntersectionTests[type]);
+            Print(output, "}, ");
+        }
+        Print(output, "\"rays_per_second\": %.0f, \"thread_busy_seconds\": [", RaysPerSecond(frame));
+        for(size_t t = 0; t < frame.BusySeconds.size(); ++t)
+            Print(output, t ? ", %.6f" : "%.6f", frame.BusySeconds[t]);
+        output.Put(']');
+    }
+
+    static void WriteCSVWork(OutputSink &output, const Frame &frame)
+    {
+        const RayCounters &c = frame.Counters;
+        Print(output, ",%.6f,%llu", frame.WallSeconds, (unsigned long long)c.PrimaryRays);
+        if(RayCounters::Enabled())
+        {
+            Print(output, ",%llu,%llu,%llu,%llu", (unsigned long long)c.ReflectionRays,
+                (unsigned long long)c.RefractionRays, (unsigned long long)c.ShadowRays,
+                (unsigned long long)c.BlockedShadowRays);
+            for(int type = 0; type < RayCounters::ShapeTypes; ++type)
+                Print(output, ",%llu", (unsigned long long)c.IntersectionTests[type]);
+        }
+        Print(output, ",%.0f", RaysPerSecond(frame));
+        for(size_t t = 0; t < frame.BusySeconds.size(); ++t)
+            Print(output, ",%.6f", frame.BusySeconds[t]);
+        output.Put('\n');
+    }
+};
+#endif // TIMINGREPORT_CPP
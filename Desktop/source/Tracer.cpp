@@ -0,0 +1,187 @@
+#ifndef TRACER_CPP
+#define TRACER_CPP
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include "../include/Vector.hpp"
+#include "../include/OutputSink.hpp"
+
+// Timeline of what every thread did, e.g. rendering tiles or quantizing frames, saved in the
+// Chrome trace event format, which is opened by chrome://tracing or ui.perfetto.dev. Nothing
+// is recorded until Tracer::Start is called, so spans cost one check of a flag otherwise.
+// Every thread records its spans into its own ring buffer without any locks. When the ring
+// is full, the oldest spans are overwritten. The buffers are read only by Tracer::Write at the
+// end, when no spans are being recorded.
+
+// Span recorded by a thread. Times are in nanoseconds since Tracer::Start.
+struct TraceEvent
+{
+    // Must live until the trace is written, e.g. a string literal.
+    const char *Name;
+    uint64_t Begin, End;
+};
+
+// Ring buffer of the spans of one thread.
+struct TraceBuffer
+{
+    std::vector<TraceEvent> Events;
+    // Number of spans ever recorded. Written only by the owning thread.
+    std::atomic<uint64_t> Count;
+    uint32_t ThreadId;
+    char ThreadName[32];
+
+    TraceBuffer(const size_t capacity, const uint32_t threadId)
+        : Events(capacity), Count(0), ThreadId(threadId)
+    {
+        ThreadName[0] = '\0';
+    }
+
+    void Add(const char *name, const uint64_t begin, const uint64_t end)
+    {
+        const uint64_t count = Count.load(std::memory_order_relaxed);
+        TraceEvent &event = Events[count % Events.size()];
+        event.Name = name;
+        event.Begin = begin;
+        event.End = end;
+        Count.store(count + 1, std::memory_order_release);
+    }
+};
+
+class Tracer
+{
+public:
+    // Starts recording spans. Every thread keeps its last eventsPerThread spans.
+    static void Start(const size_t eventsPerThread = 1 << 16)
+    {
+        Shared &state = State();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        state.Capacity = eventsPerThread > 0 ? eventsPerThread : 1;
+        state.Origin = std::chrono::steady_clock::now();
+        state.Active.store(true, std::memory_order_release);
+    }
+
+    static bool Active()
+    {
+        return State().Active.load(std::memory_order_acquire);
+    }
+
+    // Nanoseconds since Start.
+    static uint64_t Now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - State().Origin).count();
+    }
+
+    // Names the calling thread in the timeline, e.g. "renderer 3" for ("renderer", 3), or
+    // name alone, if index is negative. A thread keeps its first name.
+    static void NameThread(const char *name, const int index = -1)
+    {
+        if(!Active())
+            return;
+        TraceBuffer *const buffer = ThreadBuffer();
+        if(buffer->ThreadName[0] != '\0')
+            return;
+        if(index < 0)
+            std::snprintf(buffer->ThreadName, sizeof(buffer->ThreadName), "%s", name);
+        else
+            std::snprintf(buffer->ThreadName, sizeof(buffer->ThreadName), "%s %d", name, index);
+    }
+
+    // Buffer of the calling thread, which is created at its first span.
+    static TraceBuffer* ThreadBuffer()
+    {
+        static thread_local TraceBuffer *buffer = nullptr;
+        if(!buffer)
+        {
+            Shared &state = State();
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            state.Buffers.emplace_back(new TraceBuffer(state.Capacity, (uint32_t)state.Buffers.size() + 1));
+            buffer = state.Buffers.back().get();
+        }
+        return buffer;
+    }
+
+    // Writes the spans of all threads to a file, or to the standard output, if path is "-".
+    // Must be called, when no thread records spans. Returns false, if the file could not be
+    // written.
+    static bool Write(const std::string &path)
+    {
+        std::unique_ptr<OutputSink> output = OpenOutputSink(path.c_str());
+        if(!output)
+            return false;
+        Shared &state = State();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        Print(*output, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        bool first = true;
+        for(size_t b = 0; b < state.Buffers.size(); ++b)
+        {
+            const TraceBuffer &buffer = *state.Buffers[b];
+            if(buffer.ThreadName[0] != '\0')
+            {
+                Print(*output, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                    "\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", buffer.ThreadId, buffer.ThreadName);
+                first = false;
+            }
+            const uint64_t count = buffer.Count.load(std::memory_order_acquire);
+            const uint64_t kept = std::min(count, (uint64_t)buffer.Events.size());
+            for(uint64_t i = count - kept; i < count; ++i)
+            {
+                const TraceEvent &event = buffer.Events[i % buffer.Events.size()];
+                Print(*output, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                    first ? "" : ",\n", event.Name, buffer.ThreadId, event.Begin * 1e-3, (event.End - event.Begin) * 1e-3);
+                first = false;
+            }
+        }
+        Print(*output, "\n]}\n");
+        return output->Close();
+    }
+
+private:
+    struct Shared
+    {
+        std::atomic<bool> Active;
+        std::mutex Mutex;
+        size_t Capacity;
+        std::chrono::steady_clock::time_point Origin;
+        // Buffers of all threads, which recorded spans, kept after the threads exit.
+        std::vector<std::unique_ptr<TraceBuffer>> Buffers;
+
+        Shared() : Active(false), Capacity(1) {}
+    };
+
+    static Shared& State()
+    {
+        static Shared state;
+        return state;
+    }
+};
+
+// Records a span from its construction to its destruction on the calling thread, if the
+// tracer is active.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : Name(name), Buffer(Tracer::Active() ? Tracer::ThreadBuffer() : nullptr),
+          Begin(Buffer ? Tracer::Now() : 0) {}
+    ~TraceScope()
+    {
+        if(Buffer)
+            Buffer->Add(Name, Begin, Tracer::Now());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char *Name;
+    TraceBuffer *Buffer;
+    uint64_t Begin;
+};
+#endif // TRACER_CPP
@@ -0,0 +1,187 @@
+#ifndef VIDEOWRITER_CPP
+#define VIDEOWRITER_CPP
+
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include "../include/Vector.hpp"
+#include "../include/OutputSink.hpp"
+
+// Uncompressed video for external encoders, e.g. "3DRenderer - | ffmpeg -i - out.mp4".
+// - Y4M is YUV4MPEG2 with BT.601 colors and chroma subsampled 2x2 (4:2:0). Y, U and V use
+//   the full range 0-255 like JPEG, not 16-235, which the header states with XCOLORRANGE=FULL,
+//   so encoders do not stretch the colors again.
+// - RawRGBA is the frames exactly as rendered, one after another, without any header.
+enum class VideoFormat { Y4M, RawRGBA };
+
+class VideoWriter
+{
+public:
+    VideoWriter() : Format(VideoFormat::Y4M), Width(0), Height(0) {}
+    ~VideoWriter() { End(); }
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    // Starts a video of width x height frames shown for delay hundredths of a second each,
+    // like in GifBegin, which is written to output and closed by End.
+    bool Begin(std::unique_ptr<OutputSink> output, const VideoFormat format, const uint32_t width,
+        const uint32_t height, const uint32_t delay)
+    {
+        End();
+        if(!output)
+            return false;
+        Output = std::move(output);
+        Format = format;
+        Width = width;
+        Height = height;
+        if(Format == VideoFormat::Y4M)
+        {
+            char header[128];
+            const int headerLength = std::snprintf(header, sizeof(header),
+                "YUV4MPEG2 W%u H%u F100:%u Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, delay > 0 ? delay : 1);
+            Output->Write(header, (size_t)headerLength);
+            Planes.resize((size_t)width * height + 2 * ChromaSize());
+        }
+        return true;
+    }
+
+    // Writes a frame of Width * Height RGBA pixels.
+    bool WriteFrame(const byte *frame)
+    {
+        if(!Output) return false;
+        if(Format == VideoFormat::RawRGBA)
+            Output->Write(frame, (size_t)Width * Height * 4);
+        else
+        {
+            byte *const y = Planes.data(), *const u = y + (size_t)Width * Height, *const v = u + ChromaSize();
+            ConvertToYUV420(frame, Width, Height, y, u, v);
+            Output->Write("FRAME\n", 6);
+            Output->Write(Planes.data(), Planes.size());
+        }
+        return !Output->Failed();
+    }
+
+    // Closes the output. Returns false, if it could not be written.
+    bool End()
+    {
+        if(!Output) return false;
+        const bool written = Output->Close();
+        Output.reset();
+        return written;
+    }
+
+    // Converts RGBA pixels to the Y plane (width x height) and the U and V planes, which have
+    // one sample for every 2x2 pixels. Pixels on the right and bottom edges are repeated,
+    // if width or height is odd.
+    static void ConvertToYUV420(const byte *rgba, const uint32_t width, const uint32_t height,
+        byte *y, byte *u, byte *v)
+    {
+        const uint32_t chromaWidth = (width + 1) / 2;
+        for(uint32_t row = 0; row < height; row += 2)
+        {
+            const byte *row0 = rgba + (size_t)row * width * 4;
+            const byte *row1 = row + 1 < height ? row0 + (size_t)width * 4 : row0;
+            byte *y0 = y + (size_t)row * width, *y1 = row + 1 < height ? y0 + width : NULL;
+            byte *uRow = u + (size_t)(row / 2) * chromaWidth, *vRow = v + (size_t)(row / 2) * chromaWidth;
+            uint32_t x = 0;
+#if VECTOR_SIMD
+            for( ; x + 8 <= width; x += 8)
+                ConvertBlock(row0 + x * 4, row1 + x * 4, y0 + x, y1 ? y1 + x : NULL, uRow + x / 2, vRow + x / 2);
+#endif
+            for( ; x < width; x += 2)
+            {
+                const uint32_t x1 = x + 1 < width ? x + 1 : x;
+                const byte *p[4] = { row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4 };
+                y0[x] = Luma(p[0]);
+                if(x1 != x) y0[x1] = Luma(p[1]);
+                if(y1)
+                {
+                    y1[x] = Luma(p[2]);
+                    if(x1 != x) y1[x1] = Luma(p[3]);
+                }
+                const int r = p[0][0] + p[1][0] + p[2][0] + p[3][0],
+                    g = p[0][1] + p[1][1] + p[2][1] + p[3][1],
+                    b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+                uRow[x / 2] = Chroma(-43 * r - 85 * g + 128 * b);
+                vRow[x / 2] = Chroma(128 * r - 107 * g - 21 * b);
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<OutputSink> Output;
+    VideoFormat Format;
+    uint32_t Width, Height;
+    // Y, U and V planes of the current frame.
+    std::vector<byte> Planes;
+
+    size_t ChromaSize() const
+    {
+        return (size_t)((Width + 1) / 2) * ((Height + 1) / 2);
+    }
+
+    // The conversion is done in fixed point with 8 fractional bits:
+    // Y = 0.299 R + 0.587 G + 0.114 B, U = -0.169 R - 0.331 G + 0.5 B + 128,
+    // V = 0.5 R - 0.419 G - 0.081 B + 128
+    static byte Luma(const byte *p)
+    {
+        return (byte)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+    // sum is the chroma of the sum of 4 pixels times 256.
+    static byte Chroma(const int sum)
+    {
+        const int c = ((sum + 512) >> 10) + 128;
+        return (byte)(c < 0 ? 0 : c > 255 ? 255 : c);
+    }
+
+#if VECTOR_SIMD
+    // Same as the scalar loop for 8 pixels of two rows. y1 is NULL for the last odd row.
+    static void ConvertBlock(const byte *row0, const byte *row1, byte *y0, byte *y1, byte *u, byte *v)
+    {
+        __m128i r0, g0, b0, r1, g1, b1;
+        Deinterleave(row0, r0, g0, b0);
+        Deinterleave(row1, r1, g1, b1);
+        _mm_storel_epi64((__m128i*)y0, Luma(r0, g0, b0));
+        if(y1)
+            _mm_storel_epi64((__m128i*)y1, Luma(r1, g1, b1));
+
+        // sums of 2x2 pixels as 4 16-bit values
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i r = _mm_packs_epi32(_mm_madd_epi16(_mm_add_epi16(r0, r1), ones), _mm_setzero_si128());
+        const __m128i g = _mm_packs_epi32(_mm_madd_epi16(_mm_add_epi16(g0, g1), ones), _mm_setzero_si128());
+        const __m128i b = _mm_packs_epi32(_mm_madd_epi16(_mm_add_epi16(b0, b1), ones), _mm_setzero_si128());
+        // (r, g) and (b, 1) pairs multiplied by pairs of coefficients and added by madd
+        const __m128i rg = _mm_unpacklo_epi16(r, g), b1s = _mm_unpacklo_epi16(b, ones);
+        const __m128i us = _mm_add_epi32(_mm_madd_epi16(rg, _mm_setr_epi16(-43, -85, -43, -85, -43, -85, -43, -85)),
+            _mm_madd_epi16(b1s, _mm_setr_epi16(128, 512, 128, 512, 128, 512, 128, 512)));
+        const __m128i vs = _mm_add_epi32(_mm_madd_epi16(rg, _mm_setr_epi16(128, -107, 128, -107, 128, -107, 128, -107)),
+            _mm_madd_epi16(b1s, _mm_setr_epi16(-21, 512, -21, 512, -21, 512, -21, 512)));
+        const __m128i offset = _mm_set1_epi32(128);
+        const __m128i uc = _mm_add_epi32(_mm_srai_epi32(us, 10), offset), vc = _mm_add_epi32(_mm_srai_epi32(vs, 10), offset);
+        const __m128i uv = _mm_packus_epi16(_mm_packs_epi32(uc, vc), _mm_setzero_si128());
+        const int uBytes = _mm_cvtsi128_si32(uv), vBytes = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+        memcpy(u, &uBytes, 4);
+        memcpy(v, &vBytes, 4);
+    }
+
+    // Splits 8 RGBA pixels into 16-bit R, G and B values.
+    static void Deinterleave(const byte *p, __m128i &r, __m128i &g, __m128i &b)
+    {
+        const __m128i low = _mm_loadu_si128((const __m128i*)p), high = _mm_loadu_si128((const __m128i*)(p + 16));
+        const __m128i mask = _mm_set1_epi32(0xff);
+        r = _mm_packs_epi32(_mm_and_si128(low, mask), _mm_and_si128(high, mask));
+        g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), mask), _mm_and_si128(_mm_srli_epi32(high, 8), mask));
+        b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), mask), _mm_and_si128(_mm_srli_epi32(high, 16), mask));
+    }
+
+    // 8 luma values in the low 8 bytes. The sum fits in 16 bits without a sign.
+    static __m128i Luma(const __m128i r, const __m128i g, const __m128i b)
+    {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(77)), _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+        sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+        return _mm_packus_epi16(sum, sum);
+    }
+#endif
+};
+#endif // VIDEOWRITER_CPP
@@ -0,0 +1,122 @@
+// Saves images with QOISaver, decodes them as the QOI specification (https://qoiformat.org)
+// describes and checks, that every pixel comes back with its color and alpha 255. Returns
+// 1, if any image does not.
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../include/ImageSaver.hpp"
+
+// Decoder written after the specification, independently of QOISaver. Returns false, if data
+// is not a valid QOI image.
+static bool DecodeQOI(const byte *data, const size_t size, unsigned int &width, unsigned int &height, std::vector<byte> &rgba)
+{
+    if(size < 14 + 8 || data[0] != 'q' || data[1] != 'o' || data[2] != 'i' || data[3] != 'f')
+        return false;
+    width = (unsigned int)data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+    height = (unsigned int)data[8] << 24 | data[9] << 16 | data[10] << 8 | data[11];
+    rgba.resize((size_t)width * height * 4);
+    byte index[64][4] = {};
+    byte pixel[4] = { 0, 0, 0, 255 };
+    size_t p = 14;
+    int run = 0;
+    for(size_t i = 0; i < rgba.size(); i += 4)
+    {
+        if(run > 0)
+            --run;
+        else
+        {
+            if(p >= size - 8)
+                return false;
+            const byte op = data[p++];
+            if(op == 0xfe)
+            {
+                pixel[0] = data[p]; pixel[1] = data[p + 1]; pixel[2] = data[p + 2];
+                p += 3;
+            }
+            else if(op == 0xff)
+            {
+                pixel[0] = data[p]; pixel[1] = data[p + 1]; pixel[2] = data[p + 2]; pixel[3] = data[p + 3];
+                p += 4;
+            }
+            else if((op & 0xc0) == 0x00)
+                for(int c = 0; c < 4; ++c)
+                    pixel[c] = index[op][c];
+            else if((op & 0xc0) == 0x40)
+            {
+                pixel[0] += ((op >> 4) & 3) - 2;
+                pixel[1] += ((op >> 2) & 3) - 2;
+                pixel[2] += (op & 3) - 2;
+            }
+            else if((op & 0xc0) == 0x80)
+            {
+                const int dg = (op & 0x3f) - 32, second = data[p++];
+                pixel[0] += dg - 8 + (second >> 4);
+                pixel[1] += dg;
+                pixel[2] += dg - 8 + (second & 0x0f);
+            }
+            else
+                run = op & 0x3f;
+            const int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+            for(int c = 0; c < 4; ++c)
+                index[hash][c] = pixel[c];
+        }
+        for(int c = 0; c < 4; ++c)
+            rgba[i + c] = pixel[c];
+    }
+    static const byte end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    return size - p == 8 && std::equal(end, end + 8, data + p);
+}
+
+// Saves the image in bands of bandRows rows, decodes it and compares it with pixels.
+static bool RoundTrip(const char *name, const unsigned int width, const unsigned int height,
+    const std::vector<byte> &pixels, const unsigned int bandRows)
+{
+    QOISaver saver;
+    MemorySink output;
+    saver.Begin(output, width, height);
+    for(unsigned int top = 0; top < height; top += bandRows)
+        saver.WriteRows(output, pixels.data() + (size_t)top * width * 4, std::min(bandRows, height - top), 0);
+    saver.End(output);
+
+    unsigned int decodedWidth, decodedHeight;
+    std::vector<byte> decoded;
+    bool passed = DecodeQOI(output.Data(), output.Size(), decodedWidth, decodedHeight, decoded) &&
+        decodedWidth == width && decodedHeight == height;
+    for(size_t i = 0; passed && i < pixels.size(); i += 4)
+        passed = decoded[i] == pixels[i] && decoded[i + 1] == pixels[i + 1] && decoded[i + 2] == pixels[i + 2] &&
+            decoded[i + 3] == 255;
+    printf("%-10s %s\n", name, passed ? "passed" : "FAILED");
+    return passed;
+}
+
+int main()
+{
+    bool passed = true;
+
+    // black after another color used to be written as the unused index entry of (0, 0, 0, 0)
+    const std::vector<byte> blackAfterRed = { 255, 0, 0, 255, 0, 0, 0, 255, 10, 200, 30, 255 };
+    passed &= RoundTrip("black", 3, 1, blackAfterRed, 1);
+
+    // gradients for DIFF and LUMA, runs, repeated colors for INDEX and noise for RGB; the
+    // alpha of the source is ignored, as by all savers
+    const unsigned int width = 97, height = 61;
+    std::vector<byte> image((size_t)width * height * 4);
+    srand(1);
+    for(unsigned int y = 0; y < height; ++y)
+        for(unsigned int x = 0; x < width; ++x)
+        {
+            byte *const p = &image[((size_t)y * width + x) * 4];
+            const int region = (x / 16 + y / 16) % 4;
+            p[0] = (byte)(region == 0 ? x + y : region == 1 ? 0 : region == 2 ? (x % 3) * 80 : rand());
+            p[1] = (byte)(region == 0 ? 2 * x : region == 1 ? 0 : region == 2 ? (y % 2) * 120 : rand());
+            p[2] = (byte)(region == 0 ? 3 * y : region == 1 ? (x > 40) * 255 : region == 2 ? 7 : rand());
+            p[3] = (byte)rand();
+        }
+    passed &= RoundTrip("image", width, height, image, height);
+    passed &= RoundTrip("bands", width, height, image, 7);
+
+    // runs longer than 62 pixels across rows
+    passed &= RoundTrip("run", width, height, std::vector<byte>(image.size(), 0), 5);
+
+    return passed ? 0 : 1;
+}